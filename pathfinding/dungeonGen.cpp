@@ -96,9 +96,12 @@ void gen_drunk_dungeon(char *tiles, const size_t w, const size_t h,
 void spill_drunk_water(char *tiles, const size_t w, const size_t h,
                        const size_t num_iter, const size_t max_spills)
 {
+  // spilled tiles turn into water and are dropped from the list as they come up
+  dungeon::WalkableTiles walkable;
+  dungeon::collect_walkable_tiles(walkable, tiles, w, h);
   for (size_t iter = 0; iter < num_iter; ++iter)
   {
-    Position p = dungeon::find_walkable_tile(tiles, w, h);
+    Position p = dungeon::pick_walkable_tile(walkable, tiles, w);
     // select random point on map
     size_t x = size_t(p.x);
     size_t y = size_t(p.y);
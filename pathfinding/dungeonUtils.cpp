@@ -2,17 +2,33 @@
 #include "raylib.h"
 #include <vector>
 
-Position dungeon::find_walkable_tile(const char *dungeon, const size_t width, const size_t height)
+void dungeon::collect_walkable_tiles(WalkableTiles &walkable, const char *dungeon, const size_t width,
+                                     const size_t height)
 {
-  Position res{0, 0};
-  // prebuild all walkable and get one of them
-  std::vector<Position> posList;
+  walkable.tiles.clear();
   for (size_t y = 0; y < height; ++y)
     for (size_t x = 0; x < width; ++x)
       if (dungeon[y * width + x] == dungeon::floor)
-        posList.push_back(Position{int(x), int(y)});
-  size_t rndIdx = size_t(GetRandomValue(0, int(posList.size()) - 1));
-  res = posList[rndIdx];
-  return res;
+        walkable.tiles.push_back(Position{int(x), int(y)});
+}
+
+Position dungeon::pick_walkable_tile(WalkableTiles &walkable, const char *dungeon, const size_t width)
+{
+  while (!walkable.tiles.empty())
+  {
+    size_t rndIdx = size_t(GetRandomValue(0, int(walkable.tiles.size()) - 1));
+    const Position res = walkable.tiles[rndIdx];
+    if (dungeon[size_t(res.y) * width + size_t(res.x)] == dungeon::floor)
+      return res;
+    walkable.tiles[rndIdx] = walkable.tiles.back();
+    walkable.tiles.pop_back();
+  }
+  return Position{0, 0};
 }
 
+Position dungeon::find_walkable_tile(const char *dungeon, const size_t width, const size_t height)
+{
+  WalkableTiles walkable;
+  collect_walkable_tiles(walkable, dungeon, width, height);
+  return pick_walkable_tile(walkable, dungeon, width);
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include "math.h"
 #include <cstddef>
+#include <vector>
 
 namespace dungeon
 {
@@ -8,5 +9,16 @@ namespace dungeon
   constexpr char floor = ' ';
   constexpr char water = 'o';
 
+  // floor tiles of a dungeon collected once, tiles which stopped being floor since then are dropped
+  // when they get picked, so picking stays O(1) amortized while the dungeon is edited
+  struct WalkableTiles
+  {
+    std::vector<Position> tiles;
+  };
+
+  void collect_walkable_tiles(WalkableTiles &walkable, const char *dungeon, const size_t width, const size_t height);
+  // {0, 0} if no floor tiles are left
+  Position pick_walkable_tile(WalkableTiles &walkable, const char *dungeon, const size_t width);
+  // collects the tiles every call, use the cached version above for repeated picks
   Position find_walkable_tile(const char *dungeon, const size_t width, const size_t height);
 }
@@ -216,8 +216,10 @@ int main(int /*argc*/, const char ** /*argv*/)
   spill_drunk_water(navGrid, dungWidth, dungHeight, 8, 10);
   float weight = 1.f;
 
-  Position from = dungeon::find_walkable_tile(navGrid, dungWidth, dungHeight);
-  Position to = dungeon::find_walkable_tile(navGrid, dungWidth, dungHeight);
+  dungeon::WalkableTiles walkable;
+  dungeon::collect_walkable_tiles(walkable, navGrid, dungWidth, dungHeight);
+  Position from = dungeon::pick_walkable_tile(walkable, navGrid, dungWidth);
+  Position to = dungeon::pick_walkable_tile(walkable, navGrid, dungWidth);
 
   Camera2D camera = { {0, 0}, {0, 0}, 0.f, 1.f };
   //camera.offset = Vector2{ width * 0.5f, height * 0.5f };
@@ -249,8 +251,9 @@ int main(int /*argc*/, const char ** /*argv*/)
     {
       gen_drunk_dungeon(navGrid, dungWidth, dungHeight, 24, 100);
       spill_drunk_water(navGrid, dungWidth, dungHeight, 8, 10);
-      from = dungeon::find_walkable_tile(navGrid, dungWidth, dungHeight);
-      to = dungeon::find_walkable_tile(navGrid, dungWidth, dungHeight);
+      dungeon::collect_walkable_tiles(walkable, navGrid, dungWidth, dungHeight);
+      from = dungeon::pick_walkable_tile(walkable, navGrid, dungWidth);
+      to = dungeon::pick_walkable_tile(walkable, navGrid, dungWidth);
     }
     if (IsKeyPressed(KEY_UP))
     {
@@ -2,8 +2,11 @@
 #include <flecs.h>
 #include "ecsTypes.h"
 #include "raylib.h"
+#include "randomStream.h"
 #include <cfloat>
 #include <cmath>
+#include <utility>
+#include <vector>
 
 class AttackEnemyState : public State
 {
@@ -42,28 +45,41 @@ static int inverse_move(int move)
 
 
 template<typename Callable>
-static void on_closest_enemy_pos(flecs::world &ecs, flecs::entity entity, Callable c)
+static void on_closest_enemy_pos(flecs::world &, flecs::entity entity, Callable c)
+{
+  entity.insert([&](const Position &pos, const EnemySensor &sensor, Action &a)
+  {
+    if (sensor.found)
+      c(a, pos, sensor.pos);
+  });
+}
+
+void update_enemy_sensors(flecs::world &ecs)
 {
   static auto enemiesQuery = ecs.query<const Position, const Team>();
-  entity.insert([&](const Position &pos, const Team &t, Action &a)
+  static auto sensorsQuery = ecs.query<const Position, const Team, EnemySensor>();
+  // listed once, so each sensor scans a plain array instead of iterating the query
+  static std::vector<std::pair<Position, int>> others;
+  others.clear();
+  enemiesQuery.each([&](const Position &epos, const Team &et)
+  {
+    others.emplace_back(epos, et.team);
+  });
+  sensorsQuery.each([&](const Position &pos, const Team &t, EnemySensor &sensor)
   {
-    flecs::entity closestEnemy;
-    float closestDist = FLT_MAX;
-    Position closestPos;
-    enemiesQuery.each([&](flecs::entity enemy, const Position &epos, const Team &et)
+    sensor = EnemySensor{};
+    for (const std::pair<Position, int> &other : others)
     {
-      if (t.team == et.team)
-        return;
-      float curDist = dist(epos, pos);
-      if (curDist < closestDist)
+      if (other.second == t.team)
+        continue;
+      const float curDist = dist(other.first, pos);
+      if (curDist < sensor.dist)
       {
-        closestDist = curDist;
-        closestPos = epos;
-        closestEnemy = enemy;
+        sensor.dist = curDist;
+        sensor.pos = other.first;
+        sensor.found = true;
       }
-    });
-    if (ecs.is_valid(closestEnemy))
-      c(a, pos, closestPos);
+    }
   });
 }
 
@@ -105,14 +121,14 @@ public:
   void exit() const override {}
   void act(float/* dt*/, flecs::world &ecs, flecs::entity entity) const override
   {
-    entity.insert([&](const Position &pos, const PatrolPos &ppos, Action &a)
+    entity.insert([&](const Position &pos, const PatrolPos &ppos, Action &a, RandomStream &rs)
     {
       if (dist(pos, ppos) > patrolDist)
         a.action = move_towards(pos, ppos); // do a recovery walk
       else
       {
         // do a random walk
-        a.action = GetRandomValue(EA_MOVE_START, EA_MOVE_END - 1);
+        a.action = random_int(rs, EA_MOVE_START, EA_MOVE_END - 1);
       }
     });
   }
@@ -131,22 +147,20 @@ class EnemyAvailableTransition : public StateTransition
   float triggerDist;
 public:
   EnemyAvailableTransition(float in_dist) : triggerDist(in_dist) {}
-  bool isAvailable(flecs::world &ecs, flecs::entity entity) const override
+  bool isAvailable(flecs::world &, flecs::entity entity) const override
   {
-    static auto enemiesQuery = ecs.query<const Position, const Team>();
     bool enemiesFound = false;
-    entity.get([&](const Position &pos, const Team &t)
+    entity.get([&](const EnemySensor &sensor)
     {
-      enemiesQuery.each([&](flecs::entity enemy, const Position &epos, const Team &et)
-      {
-        if (t.team == et.team)
-          return;
-        float curDist = dist(epos, pos);
-        enemiesFound |= curDist <= triggerDist;
-      });
+      enemiesFound = sensor.found && sensor.dist <= triggerDist;
     });
     return enemiesFound;
   }
+
+  void compile(PredicateProgram &prog) const override
+  {
+    prog.emit(PO_ENEMY_WITHIN, triggerDist);
+  }
 };
 
 class HitpointsLessThanTransition : public StateTransition
@@ -163,6 +177,11 @@ public:
     });
     return hitpointsThresholdReached;
   }
+
+  void compile(PredicateProgram &prog) const override
+  {
+    prog.emit(PO_HITPOINTS_LESS, threshold);
+  }
 };
 
 class EnemyReachableTransition : public StateTransition
@@ -172,6 +191,11 @@ public:
   {
     return false;
   }
+
+  void compile(PredicateProgram &prog) const override
+  {
+    prog.emit(PO_FALSE);
+  }
 };
 
 class NegateTransition : public StateTransition
@@ -185,6 +209,12 @@ public:
   {
     return !transition->isAvailable(ecs, entity);
   }
+
+  void compile(PredicateProgram &prog) const override
+  {
+    transition->compile(prog);
+    prog.emit(PO_NOT);
+  }
 };
 
 class AndTransition : public StateTransition
@@ -203,6 +233,13 @@ public:
   {
     return lhs->isAvailable(ecs, entity) && rhs->isAvailable(ecs, entity);
   }
+
+  void compile(PredicateProgram &prog) const override
+  {
+    lhs->compile(prog);
+    rhs->compile(prog);
+    prog.emit(PO_AND);
+  }
 };
 
 
@@ -16,3 +16,7 @@ StateTransition *create_hitpoints_less_than_transition(float thres);
 StateTransition *create_negate_transition(StateTransition *in);
 StateTransition *create_and_transition(StateTransition *lhs, StateTransition *rhs);
 
+// sensors
+// fills EnemySensor of every entity which has one, transitions and states only read it
+void update_enemy_sensors(flecs::world &ecs);
+
@@ -0,0 +1,281 @@
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+#include <flecs.h>
+#include "raylib.h"
+#include "../ecsTypes.h"
+#include "../stateMachine.h"
+#include "../staticStateMachine.h"
+#include "../aiLibrary.h"
+#include "../randomStream.h"
+
+// the patrol/attack/flee machine of roguelike.cpp run over many monsters through StateMachineDef with virtual
+// states and heap allocated transitions, entity by entity and batched by state, and through sfsm::Machine.
+// Both kinds of machines read the same EnemySensor: it is filled outside the timed part from a single enemy
+// walking back and forth, the game's enemy scan is linear in the number of entities and would hide the cost
+// of the machines themselves.
+
+static Position enemyPos;
+
+static float dist_to_enemy(const Position &pos)
+{
+  return sqrtf(float((pos.x - enemyPos.x) * (pos.x - enemyPos.x) + (pos.y - enemyPos.y) * (pos.y - enemyPos.y)));
+}
+
+static int move_towards(const Position &from, const Position &to)
+{
+  int deltaX = to.x - from.x;
+  int deltaY = to.y - from.y;
+  if (abs(deltaX) > abs(deltaY))
+    return deltaX > 0 ? EA_MOVE_RIGHT : EA_MOVE_LEFT;
+  return deltaY < 0 ? EA_MOVE_UP : EA_MOVE_DOWN;
+}
+
+static int inverse_move(int move)
+{
+  return move == EA_MOVE_LEFT ? EA_MOVE_RIGHT :
+         move == EA_MOVE_RIGHT ? EA_MOVE_LEFT :
+         move == EA_MOVE_UP ? EA_MOVE_DOWN :
+         move == EA_MOVE_DOWN ? EA_MOVE_UP : move;
+}
+
+static int patrol_move(const Position &pos, const PatrolPos &ppos, float patrol_dist, RandomStream &rs)
+{
+  const float patrolDist = sqrtf(float((pos.x - ppos.x) * (pos.x - ppos.x) + (pos.y - ppos.y) * (pos.y - ppos.y)));
+  if (patrolDist > patrol_dist)
+    return move_towards(pos, Position{ppos.x, ppos.y});
+  return random_int(rs, EA_MOVE_START, EA_MOVE_END - 1);
+}
+
+// runtime machine, exactly the one of roguelike.cpp
+static StateMachineDef make_runtime_sm()
+{
+  StateMachineDef sm;
+  int patrol = sm.addState(create_patrol_state(3.f));
+  int moveToEnemy = sm.addState(create_move_to_enemy_state());
+  int fleeFromEnemy = sm.addState(create_flee_from_enemy_state());
+
+  sm.addTransition(create_enemy_available_transition(3.f), patrol, moveToEnemy);
+  sm.addTransition(create_negate_transition(create_enemy_available_transition(5.f)), moveToEnemy, patrol);
+
+  sm.addTransition(create_and_transition(create_hitpoints_less_than_transition(60.f), create_enemy_available_transition(5.f)),
+                   moveToEnemy, fleeFromEnemy);
+  sm.addTransition(create_and_transition(create_hitpoints_less_than_transition(60.f), create_enemy_available_transition(3.f)),
+                   patrol, fleeFromEnemy);
+
+  sm.addTransition(create_negate_transition(create_enemy_available_transition(7.f)), fleeFromEnemy, patrol);
+  return sm;
+}
+
+// compile time machine, the same states and transitions over the components of a query
+struct StaticSmState
+{
+  int state = 0;
+};
+
+struct BenchCtx
+{
+  const Position &pos;
+  const PatrolPos &ppos;
+  const Hitpoints &hp;
+  const EnemySensor &sensor;
+  Action &action;
+  RandomStream &rs;
+};
+
+// distances and thresholds are given in tenths, float template arguments need a newer compiler than we support
+template<int DistTenths>
+struct EnemyAvailable
+{
+  static bool check(const BenchCtx &ctx) { return ctx.sensor.found && ctx.sensor.dist <= float(DistTenths) / 10.f; }
+};
+
+template<int ThresTenths>
+struct HitpointsLessThan
+{
+  static bool check(const BenchCtx &ctx) { return ctx.hp.hitpoints < float(ThresTenths) / 10.f; }
+};
+
+struct NoEnterExit
+{
+  static void enter(BenchCtx &) {}
+  static void exit(BenchCtx &) {}
+};
+
+template<int DistTenths>
+struct PatrolState : NoEnterExit
+{
+  static void act(BenchCtx &ctx)
+  {
+    ctx.action.action = patrol_move(ctx.pos, ctx.ppos, float(DistTenths) / 10.f, ctx.rs);
+  }
+};
+
+struct MoveToEnemyState : NoEnterExit
+{
+  static void act(BenchCtx &ctx)
+  {
+    if (ctx.sensor.found)
+      ctx.action.action = move_towards(ctx.pos, ctx.sensor.pos);
+  }
+};
+
+struct FleeFromEnemyState : NoEnterExit
+{
+  static void act(BenchCtx &ctx)
+  {
+    if (ctx.sensor.found)
+      ctx.action.action = inverse_move(move_towards(ctx.pos, ctx.sensor.pos));
+  }
+};
+
+enum { ST_PATROL, ST_MOVE_TO_ENEMY, ST_FLEE_FROM_ENEMY };
+using StaticPatrolAttackFleeSm = sfsm::Machine<std::tuple<PatrolState<30>, MoveToEnemyState, FleeFromEnemyState>,
+  sfsm::Transition<ST_PATROL, ST_MOVE_TO_ENEMY, EnemyAvailable<30>>,
+  sfsm::Transition<ST_MOVE_TO_ENEMY, ST_PATROL, sfsm::Not<EnemyAvailable<50>>>,
+  sfsm::Transition<ST_MOVE_TO_ENEMY, ST_FLEE_FROM_ENEMY, sfsm::And<HitpointsLessThan<600>, EnemyAvailable<50>>>,
+  sfsm::Transition<ST_PATROL, ST_FLEE_FROM_ENEMY, sfsm::And<HitpointsLessThan<600>, EnemyAvailable<30>>>,
+  sfsm::Transition<ST_FLEE_FROM_ENEMY, ST_PATROL, sfsm::Not<EnemyAvailable<70>>>>;
+
+static Position move_pos(Position pos, int action)
+{
+  if (action == EA_MOVE_LEFT)
+    pos.x--;
+  else if (action == EA_MOVE_RIGHT)
+    pos.x++;
+  else if (action == EA_MOVE_UP)
+    pos.y--;
+  else if (action == EA_MOVE_DOWN)
+    pos.y++;
+  return pos;
+}
+
+template<typename Decide>
+static double run_turns(flecs::world &ecs, size_t turns, Decide decide)
+{
+  auto movers = ecs.query<Position, Action>();
+  auto sensors = ecs.query<const Position, EnemySensor>();
+  double ms = 0.0;
+  for (size_t turn = 0; turn < turns; ++turn)
+  {
+    // the enemy walks back and forth, so monsters keep switching states
+    enemyPos = Position{int(turn % 64) - 32, 0};
+    sensors.each([](const Position &pos, EnemySensor &sensor)
+    {
+      sensor = EnemySensor{enemyPos, dist_to_enemy(pos), true};
+    });
+    const auto start = std::chrono::steady_clock::now();
+    decide();
+    const auto end = std::chrono::steady_clock::now();
+    ms += std::chrono::duration<double, std::milli>(end - start).count();
+    movers.each([](Position &pos, Action &a)
+    {
+      pos = move_pos(pos, a.action);
+      a.action = EA_NOP;
+    });
+  }
+  return ms / double(turns);
+}
+
+int main(int /*argc*/, const char ** /*argv*/)
+{
+  const StateMachineDef runtimeSm = make_runtime_sm();
+  printf("%10s %8s %14s %14s %14s %10s %8s %8s\n", "monsters", "turns", "runtime, ms", "batched, ms", "static, ms",
+         "speedup", "batched", "static");
+  for (size_t numMonsters : {size_t(100), size_t(10000), size_t(1000000)})
+  {
+    const size_t turns = std::max(size_t(10'000'000) / numMonsters, size_t(10));
+    flecs::world ecs;
+    std::vector<flecs::entity> monsters;
+    std::vector<Position> startPos;
+    std::mt19937 rng(42u);
+    const int side = int(sqrtf(float(numMonsters))) + 8;
+    for (size_t i = 0; i < numMonsters; ++i)
+    {
+      const Position pos{int(rng() % unsigned(side)) - side / 2, int(rng() % unsigned(side)) - side / 2};
+      startPos.push_back(pos);
+      monsters.push_back(ecs.entity()
+        .set(pos)
+        .set(PatrolPos{pos.x, pos.y})
+        .set(Hitpoints{float(20 + rng() % 80)})
+        .set(Action{EA_NOP})
+        .set(EnemySensor{})
+        .set(StateMachine{runtimeSm})
+        .set(StaticSmState{})
+        .set(make_random_stream(1u, i)));
+    }
+    // every run starts from the same positions and the same per-monster streams
+    auto reset = [&]()
+    {
+      for (size_t i = 0; i < monsters.size(); ++i)
+        monsters[i].set(startPos[i]).set(make_random_stream(1u, i));
+    };
+    // where every monster ended up and the index of the state it is in, runs agree only if both match
+    auto snapshot = [&](auto state_of)
+    {
+      std::vector<int> state;
+      for (flecs::entity monster : monsters)
+      {
+        monster.get([&](const Position &pos)
+        {
+          state.push_back(pos.x);
+          state.push_back(pos.y);
+        });
+        state.push_back(state_of(monster));
+      }
+      return state;
+    };
+    auto machine_state = [](flecs::entity monster)
+    {
+      int state = 0;
+      monster.get([&](const StateMachine &sm) { state = sm.currentState(); });
+      return state;
+    };
+
+    auto runtimeQuery = ecs.query<StateMachine>();
+    const double runtimeMs = run_turns(ecs, turns, [&]()
+    {
+      runtimeQuery.each([&](flecs::entity e, StateMachine &sm) { sm.act(0.f, ecs, e); });
+    });
+    const std::vector<int> runtimeState = snapshot(machine_state);
+
+    // same machines grouped by state
+    reset();
+    for (flecs::entity monster : monsters)
+      monster.set(StateMachine{runtimeSm});
+    const double batchedMs = run_turns(ecs, turns, [&]()
+    {
+      act_state_machines_batched(0.f, ecs, runtimeQuery);
+    });
+    // monsters act in another order, but every one draws from its own stream and reads only its own sensor
+    const bool batchedMatch = runtimeState == snapshot(machine_state);
+
+    reset();
+    auto staticQuery = ecs.query<const Position, const PatrolPos, const Hitpoints, const EnemySensor, Action,
+                                 StaticSmState, RandomStream>();
+    const double staticMs = run_turns(ecs, turns, [&]()
+    {
+      staticQuery.each([](const Position &pos, const PatrolPos &ppos, const Hitpoints &hp, const EnemySensor &sensor,
+                          Action &a, StaticSmState &sm, RandomStream &rs)
+      {
+        BenchCtx ctx{pos, ppos, hp, sensor, a, rs};
+        StaticPatrolAttackFleeSm::act(sm.state, ctx);
+      });
+    });
+    const bool staticMatch = runtimeState == snapshot([](flecs::entity monster)
+    {
+      int state = 0;
+      monster.get([&](const StaticSmState &sm) { state = sm.state; });
+      return state;
+    });
+
+    printf("%10zu %8zu %14.3f %14.3f %14.3f %9.1fx %8s %8s\n", numMonsters, turns, runtimeMs, batchedMs, staticMs,
+           runtimeMs / staticMs, batchedMatch ? "yes" : "NO", staticMatch ? "yes" : "NO");
+  }
+  return 0;
+}
+
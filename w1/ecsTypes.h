@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cfloat>
+#include <cstdint>
+
 struct Position;
 struct MovePos;
 
@@ -109,5 +112,26 @@ struct Team
   int team = 0;
 };
 
+// the closest entity of another team, found once per turn before the state machines run, see update_enemy_sensors
+struct EnemySensor
+{
+  Position pos;
+  float dist = FLT_MAX;
+  bool found = false;
+};
+
 struct TextureSource {};
 
+// on the "world" entity, every RandomStream is derived from it
+struct WorldSeed
+{
+  uint64_t seed = 0;
+};
+
+// random numbers of a single entity, seeded from WorldSeed and the entity id when added;
+// drawing from it never depends on what other entities do, see randomStream.h
+struct RandomStream
+{
+  uint64_t state = 0;
+};
+
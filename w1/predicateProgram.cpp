@@ -0,0 +1,86 @@
+#include "predicateProgram.h"
+#include "stateMachine.h"
+#include "ecsTypes.h"
+#include <algorithm>
+#include <cfloat>
+
+void PredicateProgram::emit(PredicateOp op, float arg)
+{
+  code.push_back(PredicateInstr{op, arg});
+  depth = op == PO_NOT ? depth : op == PO_AND ? depth - 1 : depth + 1;
+  maxDepth = std::max(maxDepth, depth);
+  readsHitpoints |= op == PO_HITPOINTS_LESS;
+  readsEnemySensor |= op == PO_ENEMY_WITHIN;
+}
+
+void PredicateProgram::emitCall(const StateTransition *trans)
+{
+  calls.push_back(trans);
+  emit(PO_CALL);
+  code.back().call = uint32_t(calls.size() - 1);
+}
+
+void gather_predicate_inputs(std::span<const flecs::entity> entities, bool hitpoints, bool enemy_sensor,
+                             PredicateInputs &inputs)
+{
+  // entities without a component never pass a comparison against it
+  if (hitpoints)
+  {
+    inputs.hitpoints.assign(entities.size(), FLT_MAX);
+    for (size_t i = 0; i < entities.size(); ++i)
+      entities[i].get([&](const Hitpoints &hp) { inputs.hitpoints[i] = hp.hitpoints; });
+  }
+  if (enemy_sensor)
+  {
+    inputs.enemyDist.assign(entities.size(), FLT_MAX);
+    for (size_t i = 0; i < entities.size(); ++i)
+      entities[i].get([&](const EnemySensor &sensor) { inputs.enemyDist[i] = sensor.dist; });
+  }
+}
+
+void eval_predicate_batch(const PredicateProgram &prog, flecs::world &ecs, std::span<const flecs::entity> entities,
+                          const PredicateInputs &inputs, std::vector<uint8_t> &stack, std::span<uint8_t> result)
+{
+  // a row of values per stack slot
+  const size_t n = entities.size();
+  stack.resize(std::max(prog.maxDepth, size_t(1)) * n);
+  size_t top = 0;
+  for (const PredicateInstr &instr : prog.code)
+  {
+    uint8_t *row = stack.data() + top * n;
+    switch (instr.op)
+    {
+      case PO_TRUE:
+      case PO_FALSE:
+        std::fill(row, row + n, uint8_t(instr.op == PO_TRUE));
+        top++;
+        break;
+      case PO_HITPOINTS_LESS:
+        for (size_t i = 0; i < n; ++i)
+          row[i] = inputs.hitpoints[i] < instr.arg;
+        top++;
+        break;
+      case PO_ENEMY_WITHIN:
+        for (size_t i = 0; i < n; ++i)
+          row[i] = inputs.enemyDist[i] <= instr.arg;
+        top++;
+        break;
+      case PO_NOT:
+        row -= n;
+        for (size_t i = 0; i < n; ++i)
+          row[i] ^= 1;
+        break;
+      case PO_AND:
+        row -= 2 * n;
+        for (size_t i = 0; i < n; ++i)
+          row[i] &= row[n + i];
+        top--;
+        break;
+      case PO_CALL:
+        prog.calls[instr.call]->isAvailableBatch(ecs, entities, std::span<uint8_t>(row, n));
+        top++;
+        break;
+    }
+  }
+  std::copy(stack.begin(), stack.begin() + std::ptrdiff_t(n), result.begin());
+}
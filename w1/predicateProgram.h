@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <flecs.h>
+
+class StateTransition;
+
+enum PredicateOp : uint8_t
+{
+  PO_TRUE = 0,
+  PO_FALSE,
+  PO_HITPOINTS_LESS, // Hitpoints below arg
+  PO_ENEMY_WITHIN, // EnemySensor finds an enemy at most arg away
+  PO_NOT,
+  PO_AND,
+  PO_CALL // calls[call] with no opcode of its own, through StateTransition::isAvailableBatch
+};
+
+struct PredicateInstr
+{
+  PredicateOp op = PO_TRUE;
+  float arg = 0.f; // threshold of the comparisons
+  uint32_t call = 0; // index into PredicateProgram::calls for PO_CALL
+};
+
+// a transition condition flattened into postfix order, built by StateTransition::compile
+struct PredicateProgram
+{
+  std::vector<PredicateInstr> code;
+  std::vector<const StateTransition*> calls; // not owned, nodes of the compiled transition
+  size_t depth = 0; // of the value stack after the last instruction
+  size_t maxDepth = 0;
+  bool readsHitpoints = false;
+  bool readsEnemySensor = false;
+
+  void emit(PredicateOp op, float arg = 0.f);
+  void emitCall(const StateTransition *trans);
+};
+
+// components programs read, gathered once per batch instead of once per leaf
+struct PredicateInputs
+{
+  std::vector<float> hitpoints;
+  std::vector<float> enemyDist;
+};
+
+void gather_predicate_inputs(std::span<const flecs::entity> entities, bool hitpoints, bool enemy_sensor,
+                             PredicateInputs &inputs);
+
+// runs the program instruction by instruction over the whole batch, every instruction is a plain loop over
+// a row of the batch; both sides of an and are evaluated, so conditions must not have side effects.
+// `stack` is scratch owned by the caller, so evaluations nested through PO_CALL each have their own
+void eval_predicate_batch(const PredicateProgram &prog, flecs::world &ecs, std::span<const flecs::entity> entities,
+                          const PredicateInputs &inputs, std::vector<uint8_t> &stack, std::span<uint8_t> result);
+
@@ -3,11 +3,15 @@
 #include "raylib.h"
 #include "stateMachine.h"
 #include "aiLibrary.h"
+#include "randomStream.h"
+#include <random>
 
-static void add_patrol_attack_flee_sm(flecs::entity entity)
+// definitions are built on first use and shared by every entity with the same behaviour
+static const StateMachineDef &patrol_attack_flee_sm()
 {
-  entity.get([](StateMachine &sm)
+  static const StateMachineDef def = []()
   {
+    StateMachineDef sm;
     int patrol = sm.addState(create_patrol_state(3.f));
     int moveToEnemy = sm.addState(create_move_to_enemy_state());
     int fleeFromEnemy = sm.addState(create_flee_from_enemy_state());
@@ -21,27 +25,50 @@ static void add_patrol_attack_flee_sm(flecs::entity entity)
                      patrol, fleeFromEnemy);
 
     sm.addTransition(create_negate_transition(create_enemy_available_transition(7.f)), fleeFromEnemy, patrol);
-  });
+    return sm;
+  }();
+  return def;
 }
 
-static void add_patrol_flee_sm(flecs::entity entity)
+static const StateMachineDef &patrol_flee_sm()
 {
-  entity.get([](StateMachine &sm)
+  static const StateMachineDef def = []()
   {
+    StateMachineDef sm;
     int patrol = sm.addState(create_patrol_state(3.f));
     int fleeFromEnemy = sm.addState(create_flee_from_enemy_state());
 
     sm.addTransition(create_enemy_available_transition(3.f), patrol, fleeFromEnemy);
     sm.addTransition(create_negate_transition(create_enemy_available_transition(5.f)), fleeFromEnemy, patrol);
-  });
+    return sm;
+  }();
+  return def;
 }
 
-static void add_attack_sm(flecs::entity entity)
+static const StateMachineDef &attack_sm()
 {
-  entity.get([](StateMachine &sm)
+  static const StateMachineDef def = []()
   {
+    StateMachineDef sm;
     sm.addState(create_move_to_enemy_state());
-  });
+    return sm;
+  }();
+  return def;
+}
+
+static void add_patrol_attack_flee_sm(flecs::entity entity)
+{
+  entity.set(StateMachine{patrol_attack_flee_sm()});
+}
+
+static void add_patrol_flee_sm(flecs::entity entity)
+{
+  entity.set(StateMachine{patrol_flee_sm()});
+}
+
+static void add_attack_sm(flecs::entity entity)
+{
+  entity.set(StateMachine{attack_sm()});
 }
 
 static flecs::entity create_monster(flecs::world &ecs, int x, int y, Color color)
@@ -53,10 +80,11 @@ static flecs::entity create_monster(flecs::world &ecs, int x, int y, Color color
     .set(Hitpoints{100.f})
     .set(Action{EA_NOP})
     .set(Color{color})
-    .set(StateMachine{})
     .set(Team{1})
+    .set(EnemySensor{})
     .set(NumActions{1, 0})
-    .set(MeleeDamage{20.f});
+    .set(MeleeDamage{20.f})
+    .add<RandomStream>();
 }
 
 static void create_player(flecs::world &ecs, int x, int y)
@@ -135,6 +163,18 @@ void init_roguelike(flecs::world &ecs)
 {
   register_roguelike_systems(ecs);
 
+  // a new seed every run, each monster walks its own stream
+  flecs::entity worldEntity = ecs.entity("world").set(WorldSeed{uint64_t(std::random_device{}())});
+  ecs.observer<RandomStream>()
+    .event(flecs::OnAdd)
+    .each([worldEntity](flecs::entity e, RandomStream &rs)
+    {
+      worldEntity.get([&](const WorldSeed &ws)
+      {
+        rs = make_random_stream(ws.seed, e.id());
+      });
+    });
+
   add_patrol_attack_flee_sm(create_monster(ecs, 5, 5, GetColor(0xee00eeff)));
   add_patrol_attack_flee_sm(create_monster(ecs, 10, -5, GetColor(0xee00eeff)));
   add_patrol_flee_sm(create_monster(ecs, -5, -5, GetColor(0x111111ff)));
@@ -264,13 +304,9 @@ void process_turn(flecs::world &ecs)
     if (upd_player_actions_count(ecs))
     {
       // Plan action for NPCs
-      ecs.defer([&]
-      {
-        stateMachineAct.each([&](flecs::entity e, StateMachine &sm)
-        {
-          sm.act(0.f, ecs, e);
-        });
-      });
+      update_enemy_sensors(ecs);
+      // entities sitting in the same state act together
+      act_state_machines_batched(0.f, ecs, stateMachineAct);
     }
     process_actions(ecs);
   }
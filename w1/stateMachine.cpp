@@ -1,44 +1,182 @@
 #include "stateMachine.h"
+#include <algorithm>
+#include <functional>
+#include <utility>
 
-StateMachine::~StateMachine()
+StateMachineDef::~StateMachineDef()
 {
   for (State* state : states)
     delete state;
   states.clear();
   for (auto &transList : transitions)
     for (auto &transition : transList)
-      delete transition.first;
+      delete transition.condition;
   transitions.clear();
 }
 
-void StateMachine::act(float dt, flecs::world &ecs, flecs::entity entity)
+void StateMachineDef::gatherInputs(const std::vector<Transition> &trans_list, std::span<const flecs::entity> entities,
+                                   PredicateInputs &inputs)
 {
-  if (curStateIdx < states.size())
+  bool hitpoints = false;
+  bool enemySensor = false;
+  for (const Transition &transition : trans_list)
   {
-    for (const std::pair<StateTransition*, int> &transition : transitions[curStateIdx])
-      if (transition.first->isAvailable(ecs, entity))
+    hitpoints |= transition.program.readsHitpoints;
+    enemySensor |= transition.program.readsEnemySensor;
+  }
+  gather_predicate_inputs(entities, hitpoints, enemySensor, inputs);
+}
+
+void StateMachineDef::act(int &cur_state, float dt, flecs::world &ecs, flecs::entity entity) const
+{
+  if (size_t(cur_state) < states.size())
+  {
+    // a batch of one
+    const std::vector<Transition> &transList = transitions[size_t(cur_state)];
+    const std::span<const flecs::entity> single(&entity, 1);
+    gatherInputs(transList, single, scratch.inputs);
+    for (const Transition &transition : transList)
+    {
+      uint8_t available = 0;
+      eval_predicate_batch(transition.program, ecs, single, scratch.inputs, scratch.stack,
+                           std::span<uint8_t>(&available, 1));
+      if (available)
       {
-        states[curStateIdx]->exit();
-        curStateIdx = transition.second;
-        states[curStateIdx]->enter();
+        states[size_t(cur_state)]->exit();
+        cur_state = transition.to;
+        states[size_t(cur_state)]->enter();
         break;
       }
-    states[curStateIdx]->act(dt, ecs, entity);
+    }
+    states[size_t(cur_state)]->act(dt, ecs, entity);
   }
   else
-    curStateIdx = 0;
+    cur_state = 0;
 }
 
-int StateMachine::addState(State *st)
+int StateMachineDef::addState(State *st)
 {
-  int idx = states.size();
+  int idx = int(states.size());
   states.push_back(st);
-  transitions.push_back(std::vector<std::pair<StateTransition*, int>>());
+  transitions.push_back(std::vector<Transition>());
   return idx;
 }
 
-void StateMachine::addTransition(StateTransition *trans, int from, int to)
+void StateMachineDef::addTransition(StateTransition *trans, int from, int to)
 {
-  transitions[from].push_back(std::make_pair(trans, to));
+  Transition transition{trans, PredicateProgram{}, to};
+  trans->compile(transition.program);
+  transitions[size_t(from)].push_back(std::move(transition));
 }
 
+void StateMachine::act(float dt, flecs::world &ecs, flecs::entity entity)
+{
+  if (def)
+    def->act(curStateIdx, dt, ecs, entity);
+}
+
+void State::actBatch(float dt, flecs::world &ecs, std::span<const flecs::entity> entities) const
+{
+  for (flecs::entity entity : entities)
+    act(dt, ecs, entity);
+}
+
+void StateTransition::isAvailableBatch(flecs::world &ecs, std::span<const flecs::entity> entities,
+                                       std::span<uint8_t> available) const
+{
+  for (size_t i = 0; i < entities.size(); ++i)
+    available[i] = isAvailable(ecs, entities[i]);
+}
+
+void StateMachineDef::actBatch(int cur_state, float dt, flecs::world &ecs, std::span<const flecs::entity> entities,
+                               std::span<int *const> entity_states) const
+{
+  if (size_t(cur_state) >= states.size())
+  {
+    for (int *state : entity_states)
+      *state = 0;
+    return;
+  }
+  const std::vector<Transition> &transList = transitions[size_t(cur_state)];
+  std::vector<uint8_t> &available = scratch.available;
+  std::vector<size_t> &taken = scratch.taken;
+  std::vector<flecs::entity> &group = scratch.group;
+  const size_t n = entities.size();
+  gatherInputs(transList, entities, scratch.inputs);
+  available.resize(n);
+  taken.assign(n, transList.size());
+  // every condition is checked over the whole batch, earlier transitions win
+  for (size_t t = 0; t < transList.size(); ++t)
+  {
+    eval_predicate_batch(transList[t].program, ecs, entities, scratch.inputs, scratch.stack, available);
+    for (size_t i = 0; i < n; ++i)
+      taken[i] = taken[i] == transList.size() && available[i] ? t : taken[i];
+  }
+  const State *curState = states[size_t(cur_state)];
+  for (size_t t = 0; t < transList.size(); ++t)
+  {
+    const State *nextState = states[size_t(transList[t].to)];
+    group.clear();
+    for (size_t i = 0; i < n; ++i)
+      if (taken[i] == t)
+      {
+        curState->exit();
+        *entity_states[i] = transList[t].to;
+        nextState->enter();
+        group.push_back(entities[i]);
+      }
+    if (!group.empty())
+      nextState->actBatch(dt, ecs, group);
+  }
+  group.clear();
+  for (size_t i = 0; i < n; ++i)
+    if (taken[i] == transList.size())
+      group.push_back(entities[i]);
+  if (!group.empty())
+    curState->actBatch(dt, ecs, group);
+}
+
+void act_state_machines_batched(float dt, flecs::world &ecs, const flecs::query<StateMachine> &query)
+{
+  struct Member
+  {
+    const StateMachineDef *def;
+    int *state;
+    flecs::entity entity;
+  };
+  static std::vector<Member> members;
+  static std::vector<flecs::entity> entities;
+  static std::vector<int*> entityStates;
+  members.clear();
+  // component pointers stay valid until the deferred changes of acting are merged
+  ecs.defer([&]
+  {
+    query.each([&](flecs::entity e, StateMachine &sm)
+    {
+      if (sm.def)
+        members.push_back(Member{sm.def, &sm.curStateIdx, e});
+    });
+    // stable, so entities in a batch keep the query order
+    std::stable_sort(members.begin(), members.end(), [](const Member &lhs, const Member &rhs)
+    {
+      if (lhs.def != rhs.def)
+        return std::less<const StateMachineDef*>()(lhs.def, rhs.def);
+      return *lhs.state < *rhs.state;
+    });
+    for (size_t begin = 0; begin < members.size();)
+    {
+      const StateMachineDef *def = members[begin].def;
+      const int curState = *members[begin].state;
+      entities.clear();
+      entityStates.clear();
+      size_t end = begin;
+      for (; end < members.size() && members[end].def == def && *members[end].state == curState; ++end)
+      {
+        entities.push_back(members[end].entity);
+        entityStates.push_back(members[end].state);
+      }
+      def->actBatch(curState, dt, ecs, entities, entityStates);
+      begin = end;
+    }
+  });
+}
@@ -1,13 +1,19 @@
 #pragma once
+#include <cstdint>
+#include <span>
 #include <vector>
 #include <flecs.h>
+#include "predicateProgram.h"
 
 class State
 {
 public:
+  virtual ~State() {}
   virtual void enter() const = 0;
   virtual void exit() const = 0;
   virtual void act(float dt, flecs::world &ecs, flecs::entity entity) const = 0;
+  // acts for a whole batch of entities sitting in this state, by default one by one
+  virtual void actBatch(float dt, flecs::world &ecs, std::span<const flecs::entity> entities) const;
 };
 
 class StateTransition
@@ -15,27 +21,79 @@ class StateTransition
 public:
   virtual ~StateTransition() {}
   virtual bool isAvailable(flecs::world &ecs, flecs::entity entity) const = 0;
+  // available[i] tells if the transition is available for entities[i], by default checked one by one
+  virtual void isAvailableBatch(flecs::world &ecs, std::span<const flecs::entity> entities,
+                                std::span<uint8_t> available) const;
+  // appends the condition to the program, conditions without an opcode are called as they are
+  virtual void compile(PredicateProgram &prog) const { prog.emitCall(this); }
 };
 
-class StateMachine
+// states and transitions of a machine, built once and shared by every entity running it,
+// so states and transitions must not keep any per entity data
+class StateMachineDef
 {
-  int curStateIdx = 0;
+  struct Transition
+  {
+    StateTransition *condition; // owned, kept for the nodes the program calls
+    PredicateProgram program;
+    int to;
+  };
+  // reused by every act and actBatch, so evaluating transitions stops allocating once the vectors have grown;
+  // a definition is acted by one thread at a time
+  struct Scratch
+  {
+    PredicateInputs inputs;
+    std::vector<uint8_t> stack;
+    std::vector<uint8_t> available;
+    std::vector<size_t> taken; // per entity, index of the first available transition, the list size to stay
+    std::vector<flecs::entity> group;
+  };
   std::vector<State*> states;
-  std::vector<std::vector<std::pair<StateTransition*, int>>> transitions;
+  std::vector<std::vector<Transition>> transitions;
+  mutable Scratch scratch;
+
+  // reads the components any transition out of the state needs
+  static void gatherInputs(const std::vector<Transition> &trans_list, std::span<const flecs::entity> entities,
+                           PredicateInputs &inputs);
 public:
-  StateMachine() = default;
-  StateMachine(const StateMachine &sm) = default;
-  StateMachine(StateMachine &&sm) = default;
+  StateMachineDef() = default;
+  StateMachineDef(const StateMachineDef &sm) = delete;
+  StateMachineDef(StateMachineDef &&sm) = default;
 
-  ~StateMachine();
+  ~StateMachineDef();
 
-  StateMachine &operator=(const StateMachine &sm) = default;
-  StateMachine &operator=(StateMachine &&sm) = default;
+  StateMachineDef &operator=(const StateMachineDef &sm) = delete;
+  StateMachineDef &operator=(StateMachineDef &&sm) = default;
 
-
-  void act(float dt, flecs::world &ecs, flecs::entity entity);
+  // takes the first available transition out of cur_state and acts in the resulting state
+  void act(int &cur_state, float dt, flecs::world &ecs, flecs::entity entity) const;
+  // the same as act for each of the entities, all of them in cur_state; every transition is evaluated
+  // for the whole batch and every state acts once, new states are written to entity_states
+  void actBatch(int cur_state, float dt, flecs::world &ecs, std::span<const flecs::entity> entities,
+                std::span<int *const> entity_states) const;
 
   int addState(State *st);
+  // compiles the condition into a flat program, which is what gets evaluated
   void addTransition(StateTransition *trans, int from, int to);
 };
 
+// per entity part of a machine, just the current state of a shared definition
+class StateMachine
+{
+  const StateMachineDef *def = nullptr; // not owned, has to outlive the entity
+  int curStateIdx = 0;
+public:
+  StateMachine() = default;
+  explicit StateMachine(const StateMachineDef &in_def) : def(&in_def) {}
+
+  void act(float dt, flecs::world &ecs, flecs::entity entity);
+  int currentState() const { return curStateIdx; }
+
+  friend void act_state_machines_batched(float dt, flecs::world &ecs, const flecs::query<StateMachine> &query);
+};
+
+// runs the machines of every entity of the query grouped by definition and current state, so the code and
+// data of a state are used for a whole batch in a row; gives the same transitions as acting entity by entity
+// as long as states and transitions only read what acting doesn't write, only the order of acting differs
+void act_state_machines_batched(float dt, flecs::world &ecs, const flecs::query<StateMachine> &query);
+
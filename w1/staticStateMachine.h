@@ -0,0 +1,94 @@
+#pragma once
+#include <cstddef>
+#include <tuple>
+#include <utility>
+
+// Header only counterpart of StateMachineDef: states and transitions are types, so the transition
+// table is known at compile time and a whole step inlines into a switch over the current state.
+// A state is a type with static enter(ctx), exit(ctx) and act(ctx), a condition is a type with
+// a static check(ctx) returning bool; ctx is whatever the caller passes, usually references to
+// the entity's components. Only the current state index is stored per entity.
+namespace sfsm
+{
+  template<size_t From, size_t To, typename Condition>
+  struct Transition
+  {
+    static constexpr size_t from = From;
+    static constexpr size_t to = To;
+    using condition = Condition;
+  };
+
+  template<typename Condition>
+  struct Not
+  {
+    template<typename Ctx>
+    static bool check(const Ctx &ctx) { return !Condition::check(ctx); }
+  };
+
+  template<typename Lhs, typename Rhs>
+  struct And
+  {
+    template<typename Ctx>
+    static bool check(const Ctx &ctx) { return Lhs::check(ctx) && Rhs::check(ctx); }
+  };
+
+  template<typename States, typename... Transitions>
+  class Machine;
+
+  // transitions out of a state are tried in the order they are listed, like StateMachineDef::addTransition
+  template<typename... States, typename... Transitions>
+  class Machine<std::tuple<States...>, Transitions...>
+  {
+    template<size_t Idx>
+    using state_t = std::tuple_element_t<Idx, std::tuple<States...>>;
+
+    static_assert(((Transitions::from < sizeof...(States) && Transitions::to < sizeof...(States)) && ...),
+                  "transition refers to a state out of range");
+
+    template<size_t Cur, typename Trans, typename Ctx>
+    static bool try_transition(int &cur_state, Ctx &ctx)
+    {
+      if constexpr (Trans::from != Cur)
+        return false;
+      else
+      {
+        if (!Trans::condition::check(ctx))
+          return false;
+        state_t<Cur>::exit(ctx);
+        cur_state = int(Trans::to);
+        state_t<Trans::to>::enter(ctx);
+        state_t<Trans::to>::act(ctx);
+        return true;
+      }
+    }
+
+    template<size_t Cur, typename Ctx>
+    static bool step_from(int &cur_state, Ctx &ctx)
+    {
+      if (cur_state != int(Cur))
+        return false;
+      if (!(try_transition<Cur, Transitions>(cur_state, ctx) || ...))
+        state_t<Cur>::act(ctx);
+      return true;
+    }
+
+    template<typename Ctx, size_t... Idx>
+    static bool step(int &cur_state, Ctx &ctx, std::index_sequence<Idx...>)
+    {
+      return (step_from<Idx>(cur_state, ctx) || ...);
+    }
+
+  public:
+    static constexpr size_t num_states = sizeof...(States);
+
+    // same semantics as StateMachineDef::act: takes the first available transition and acts
+    // in the resulting state, an out of range state is reset to the first one
+    template<typename Ctx>
+    static void act(int &cur_state, Ctx &ctx)
+    {
+      if (!step(cur_state, ctx, std::index_sequence_for<States...>{}))
+        cur_state = 0;
+    }
+  };
+};
+
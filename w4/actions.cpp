@@ -0,0 +1,139 @@
+#include "actions.h"
+#include "dungeonUtils.h"
+#include "actionLog.h"
+#include <algorithm>
+#include <utility>
+
+static Position move_pos(Position pos, int action)
+{
+  if (action == EA_MOVE_LEFT)
+    pos.x--;
+  else if (action == EA_MOVE_RIGHT)
+    pos.x++;
+  else if (action == EA_MOVE_UP)
+    pos.y--;
+  else if (action == EA_MOVE_DOWN)
+    pos.y++;
+  return pos;
+}
+
+static void push_to_log(flecs::world &ecs, const char *msg)
+{
+  static auto queryLog = ecs.query<ActionLog, const TurnCounter>();
+  queryLog.each([&](ActionLog &l, const TurnCounter &c)
+  {
+    push_action_log(l, c.count, msg);
+  });
+}
+
+void process_actions(flecs::world &ecs, const std::vector<flecs::entity_t> &actors)
+{
+  static auto occupancyQuery = ecs.query<OccupancyGrid>();
+  static std::vector<std::pair<flecs::entity_t, float>> hits; // target and damage
+  static std::vector<flecs::entity_t> damaged;
+  hits.clear();
+  damaged.clear();
+  // Process all actions
+  ecs.defer([&]
+  {
+    for (flecs::entity_t id : actors)
+      flecs::entity(ecs, id).get([&](Action &a, Hitpoints &hp)
+      {
+        if (a.action != EA_HEAL_SELF)
+          return;
+        a.action = EA_NOP;
+        push_to_log(ecs, "Monster healed itself");
+        hp.hitpoints += 10.f;
+      });
+    occupancyQuery.each([&](OccupancyGrid &occ)
+    {
+      for (flecs::entity_t id : actors)
+      {
+        flecs::entity entity(ecs, id);
+        entity.get([&](Action &a, Position &pos, MovePos &mpos, const MeleeDamage &dmg, const Team &team)
+        {
+          Position nextPos = move_pos(pos, a.action);
+          bool blocked = !dungeon::is_tile_walkable(ecs, nextPos);
+          const flecs::entity_t occupant = dungeon::get_occupant(occ, nextPos);
+          if (occupant != 0 && occupant != entity.id())
+          {
+            flecs::entity enemy(ecs, occupant);
+            enemy.get([&](const MovePos &epos, const Team &enemy_team)
+            {
+              if (!(epos == nextPos))
+                return;
+              blocked = true;
+              if (team.team != enemy_team.team)
+                hits.emplace_back(occupant, dmg.damage);
+            });
+          }
+          if (blocked)
+            a.action = EA_NOP;
+          else
+          {
+            dungeon::move_occupant(occ, entity.id(), nextPos);
+            mpos = nextPos;
+          }
+        });
+      }
+    });
+    // hits land once every move is resolved, so no target is written from inside its attacker's get
+    for (const auto &[id, damage] : hits)
+      flecs::entity(ecs, id).get([&](Hitpoints &hp)
+      {
+        push_to_log(ecs, "damaged entity");
+        hp.hitpoints -= damage;
+        damaged.push_back(id);
+      });
+    // now move
+    for (flecs::entity_t id : actors)
+      flecs::entity(ecs, id).get([&](Action &a, Position &pos, MovePos &mpos)
+      {
+        pos = mpos;
+        a.action = EA_NOP;
+      });
+  });
+
+  // only the ones hit this turn could have died
+  std::sort(damaged.begin(), damaged.end());
+  damaged.erase(std::unique(damaged.begin(), damaged.end()), damaged.end());
+  ecs.defer([&]
+  {
+    for (flecs::entity_t id : damaged)
+    {
+      flecs::entity entity(ecs, id);
+      entity.get([&](const Hitpoints &hp)
+      {
+        if (hp.hitpoints <= 0.f)
+          entity.destruct();
+      });
+    }
+  });
+
+  static auto pickers = ecs.query<const Picker, const Position, Hitpoints, MeleeDamage>();
+  static auto pickupIndexQuery = ecs.query<PickupIndex>();
+  static std::vector<flecs::entity_t> items;
+  ecs.defer([&]
+  {
+    pickupIndexQuery.each([&](PickupIndex &index)
+    {
+      pickers.each([&](const Picker&, const Position &pos, Hitpoints &hp, MeleeDamage &dmg)
+      {
+        items.clear();
+        dungeon::take_pickups(index, pos, items);
+        for (flecs::entity_t id : items)
+        {
+          flecs::entity item(ecs, id);
+          bool onTile = false;
+          if (item.is_alive())
+            item.get([&](const Position &ppos) { onTile = pos == ppos; });
+          if (!onTile) // gone or moved since it was indexed under this tile
+            continue;
+          item.get([&](const HealAmount &amt) { hp.hitpoints += amt.amount; });
+          item.get([&](const PowerupAmount &amt) { dmg.damage += amt.amount; });
+          item.destruct();
+        }
+      });
+    });
+  });
+}
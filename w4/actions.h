@@ -0,0 +1,8 @@
+#pragma once
+#include <vector>
+#include <flecs.h>
+#include "ecsTypes.h"
+
+// heals, moves and attacks of the given actors in their order, then deaths and pickups;
+// only the actors which are due act, everybody else keeps still
+void process_actions(flecs::world &ecs, const std::vector<flecs::entity_t> &actors);
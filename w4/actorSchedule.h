@@ -0,0 +1,24 @@
+#pragma once
+#include <vector>
+#include <flecs.h>
+#include "ecsTypes.h"
+
+// adds the schedule and the activity zone to the world entity, every non player entity which gets
+// an ActionDelay is queued for its first action that many ticks from now; setting it again while
+// queued moves the action to that many ticks from the time of the set; actors are dropped from the queue
+// and from the sleepers as soon as they lose ActionDelay or Position, deleted ones included
+void init_actor_schedule(flecs::world &ecs, flecs::entity world_entity);
+// moves the clock by `ticks` and fills `due` with the living actors whose action time has come,
+// in tick order; dead ones are dropped, the rest have to be queued again with requeue_actors
+void advance_actor_schedule(flecs::world &ecs, ActorSchedule &sched, int64_t ticks,
+                            std::vector<flecs::entity_t> &due);
+// queues every actor for its next action, ActionDelay ticks from now
+void requeue_actors(flecs::world &ecs, ActorSchedule &sched, const std::vector<flecs::entity_t> &actors);
+// takes the due actors farther than zone.sleepDist out of `due` and puts them to sleep, then queues
+// the sleepers within zone.wakeDist again; only the chunks around the map's sources are looked at,
+// so sleepers cost nothing per turn. A woken actor is only rescheduled: it comes back on the tick it would
+// have acted on had it stayed awake, the actions it slept through aren't replayed and its state doesn't
+// catch up. A map which isn't generated yet keeps everybody awake
+void update_actor_activity(flecs::world &ecs, ActorSchedule &sched, ActivityZone &zone, const DungeonData &dd,
+                           const DijkstraMapData &approach_map, std::vector<flecs::entity_t> &due);
+
@@ -51,14 +51,14 @@ public:
   void exit() const override {}
   void act(float/* dt*/, flecs::world &, flecs::entity entity) const override
   {
-    entity.insert([&](const Position &pos, const PatrolPos &ppos, Action &a)
+    entity.insert([&](const Position &pos, const PatrolPos &ppos, Action &a, RandomStream &rs)
     {
       if (dist(pos, ppos) > patrolDist)
         a.action = move_towards(pos, ppos); // do a recovery walk
       else
       {
         // do a random walk
-        a.action = GetRandomValue(EA_MOVE_START, EA_MOVE_END - 1);
+        a.action = random_move(rs);
       }
     });
   }
@@ -79,11 +79,10 @@ public:
   EnemyAvailableTransition(float in_dist) : triggerDist(in_dist) {}
   bool isAvailable(flecs::world &ecs, flecs::entity entity) const override
   {
-    static auto enemiesQuery = ecs.query<const Position, const Team>();
     bool enemiesFound = false;
     entity.get([&](const Position &pos, const Team &t)
     {
-      enemiesQuery.each([&](const Position &epos, const Team &et)
+      enemies_query(ecs).iter(ecs).each([&](const Position &epos, const Team &et)
       {
         if (t.team == et.team)
           return;
@@ -0,0 +1,156 @@
+#include <cstdio>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <utility>
+#include <vector>
+#include <flecs.h>
+#include "../ecsTypes.h"
+#include "../dungeonUtils.h"
+#include "../actions.h"
+
+// stress scenario for move/attack resolution: thousands of monsters of two teams wandering a dungeon,
+// resolved either by scanning every entity per action like process_actions used to or by the game's
+// process_actions, which goes through the occupancy grid
+
+static DungeonData gen_bench_dungeon(size_t w, size_t h, unsigned seed)
+{
+  DungeonData dd;
+  dd.width = w;
+  dd.height = h;
+  dd.tiles.assign(w * h, dungeon::floor);
+  std::mt19937 rng(seed);
+  for (size_t y = 0; y < h; ++y)
+    for (size_t x = 0; x < w; ++x)
+      if (x == 0 || y == 0 || x + 1 == w || y + 1 == h || rng() % 8 == 0)
+        dd.tiles[y * w + x] = dungeon::wall;
+  dungeon::init_walkable_tiles(dd);
+  return dd;
+}
+
+static Position move_pos(Position pos, int action)
+{
+  if (action == EA_MOVE_LEFT)
+    pos.x--;
+  else if (action == EA_MOVE_RIGHT)
+    pos.x++;
+  else if (action == EA_MOVE_UP)
+    pos.y--;
+  else if (action == EA_MOVE_DOWN)
+    pos.y++;
+  return pos;
+}
+
+static void resolve_scan(flecs::world &ecs)
+{
+  static auto processActions = ecs.query<Action, Position, MovePos, const MeleeDamage, const Team>();
+  static auto checkAttacks = ecs.query<const MovePos, Hitpoints, const Team>();
+  ecs.defer([&]
+  {
+    processActions.each([&](flecs::entity entity, Action &a, Position &pos, MovePos &mpos, const MeleeDamage &dmg, const Team &team)
+    {
+      Position nextPos = move_pos(pos, a.action);
+      bool blocked = !dungeon::is_tile_walkable(ecs, nextPos);
+      checkAttacks.each([&](flecs::entity enemy, const MovePos &epos, Hitpoints &hp, const Team &enemy_team)
+      {
+        if (entity != enemy && epos == nextPos)
+        {
+          blocked = true;
+          if (team.team != enemy_team.team)
+            hp.hitpoints -= dmg.damage;
+        }
+      });
+      if (blocked)
+        a.action = EA_NOP;
+      else
+        mpos = nextPos;
+    });
+  });
+}
+
+template<typename Resolve>
+static double run_turns(flecs::world &ecs, size_t turns, unsigned seed, Resolve resolve)
+{
+  static auto actors = ecs.query<Action, Position, MovePos>();
+  std::mt19937 rng(seed);
+  double ms = 0.0;
+  for (size_t turn = 0; turn < turns; ++turn)
+  {
+    actors.each([&](Action &a, Position &, MovePos &)
+    {
+      a.action = EA_MOVE_START + int(rng() % (EA_MOVE_END - EA_MOVE_START));
+    });
+    const auto start = std::chrono::steady_clock::now();
+    resolve(ecs);
+    const auto end = std::chrono::steady_clock::now();
+    ms += std::chrono::duration<double, std::milli>(end - start).count();
+    actors.each([&](Action &a, Position &pos, MovePos &mpos)
+    {
+      pos = mpos;
+      a.action = EA_NOP;
+    });
+  }
+  return ms / double(turns);
+}
+
+int main(int /*argc*/, const char ** /*argv*/)
+{
+  // queries are cached in statics, so the whole bench runs in a single world
+  const size_t size = 500;
+  const size_t numMonsters = 10000;
+  const size_t turns = 50;
+  flecs::world ecs;
+  flecs::entity dungeonEntity = ecs.entity("dungeon").set(gen_bench_dungeon(size, size, 42u));
+  dungeon::init_occupancy(ecs, dungeonEntity);
+
+  std::vector<std::pair<flecs::entity, Position>> monsters;
+  dungeonEntity.get([&](const DungeonData &dd)
+  {
+    std::vector<size_t> floor;
+    for (size_t i = 0; i < dd.tiles.size(); ++i)
+      if (dd.tiles[i] == dungeon::floor)
+        floor.push_back(i);
+    std::shuffle(floor.begin(), floor.end(), std::mt19937(7u));
+    for (size_t i = 0; i < numMonsters; ++i)
+    {
+      const Position pos{int(floor[i] % dd.width), int(floor[i] / dd.width)};
+      monsters.emplace_back(ecs.entity()
+        .set(Position{pos.x, pos.y})
+        .set(MovePos{pos.x, pos.y})
+        .set(Hitpoints{1e9f})
+        .set(Action{EA_NOP})
+        .set(Team{int(i % 2)})
+        .set(MeleeDamage{1.f}), pos);
+    }
+  });
+  auto snapshot = [&]()
+  {
+    std::vector<float> state;
+    for (const auto &monster : monsters)
+      monster.first.get([&](const Position &pos, const Hitpoints &hp)
+      {
+        state.push_back(float(pos.x));
+        state.push_back(float(pos.y));
+        state.push_back(hp.hitpoints);
+      });
+    return state;
+  };
+
+  std::vector<flecs::entity_t> actors;
+  for (const auto &monster : monsters)
+    actors.push_back(monster.first.id());
+
+  const double scanMs = run_turns(ecs, turns, 1u, resolve_scan);
+  const std::vector<float> scanState = snapshot();
+  // back to the starting positions, the scan moved everybody without maintaining the grid
+  for (const auto &[e, pos] : monsters)
+    e.set(Position{pos.x, pos.y}).set(MovePos{pos.x, pos.y}).set(Hitpoints{1e9f});
+  dungeon::reset_occupancy(ecs, dungeonEntity);
+  const double gridMs = run_turns(ecs, turns, 1u, [&](flecs::world &w) { process_actions(w, actors); });
+  const bool match = scanState == snapshot();
+
+  printf("%10s %10s %12s %12s %10s %8s\n", "size", "monsters", "scan, ms", "grid, ms", "speedup", "match");
+  printf("%10zu %10zu %12.3f %12.3f %9.1fx %8s\n", size, numMonsters, scanMs, gridMs, scanMs / gridMs,
+         match ? "yes" : "NO");
+  return 0;
+}
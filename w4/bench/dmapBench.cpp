@@ -0,0 +1,349 @@
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <utility>
+#include <vector>
+#include "../dmapEngine.h"
+#include "../dungeonUtils.h"
+
+// cave-like dungeon dug out by a handful of drunk walkers until ~40% of tiles are floor
+static DungeonData gen_bench_dungeon(size_t w, size_t h, unsigned seed)
+{
+  DungeonData dd;
+  dd.width = w;
+  dd.height = h;
+  dd.tiles.assign(w * h, dungeon::wall);
+
+  std::mt19937 rng(seed);
+  const int dirs[4][2] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
+  const size_t targetFloor = w * h * 2 / 5;
+  size_t numFloor = 0;
+  size_t x = w / 2;
+  size_t y = h / 2;
+  while (numFloor < targetFloor)
+  {
+    if (dd.tiles[y * w + x] == dungeon::wall)
+    {
+      dd.tiles[y * w + x] = dungeon::floor;
+      numFloor++;
+    }
+    const int *dir = dirs[rng() % 4];
+    x = size_t(std::min(std::max(int(x) + dir[0], 1), int(w) - 2));
+    y = size_t(std::min(std::max(int(y) + dir[1], 1), int(h) - 2));
+  }
+  return dd;
+}
+
+// arena with walls only around the border, the best case for the raster engine
+static DungeonData gen_open_dungeon(size_t w, size_t h)
+{
+  DungeonData dd;
+  dd.width = w;
+  dd.height = h;
+  dd.tiles.assign(w * h, dungeon::floor);
+  for (size_t y = 0; y < h; ++y)
+    for (size_t x = 0; x < w; ++x)
+      if (x == 0 || y == 0 || x + 1 == w || y + 1 == h)
+        dd.tiles[y * w + x] = dungeon::wall;
+  return dd;
+}
+
+static std::vector<DmapSource> gen_sources_list(const DungeonData &dd, size_t num_sources, unsigned seed)
+{
+  std::vector<DmapSource> sources;
+  std::mt19937 rng(seed);
+  while (sources.size() < num_sources)
+  {
+    const size_t idx = rng() % dd.tiles.size();
+    if (dd.tiles[idx] == dungeon::floor)
+      sources.push_back(DmapSource{idx, 0.f});
+  }
+  return sources;
+}
+
+static std::vector<float> gen_sources(const DungeonData &dd, size_t num_sources, unsigned seed)
+{
+  std::vector<float> map;
+  dmaps::init_tiles(map, dd);
+  std::mt19937 rng(seed);
+  size_t placed = 0;
+  while (placed < num_sources)
+  {
+    const size_t idx = rng() % map.size();
+    if (dd.tiles[idx] != dungeon::floor)
+      continue;
+    map[idx] = 0.f;
+    placed++;
+  }
+  return map;
+}
+
+template<typename Callable>
+static double measure_ms(size_t reps, Callable c)
+{
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < reps; ++i)
+    c();
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count() / double(reps);
+}
+
+int main(int /*argc*/, const char ** /*argv*/)
+{
+  const size_t sizes[] = {100, 512, 2048};
+  DmapScratch scratch;
+  printf("%6s %8s %10s %12s %12s %12s %10s %8s\n", "map", "size", "floor", "scan, ms", "queue, ms", "raster, ms",
+         "speedup", "match");
+  for (bool open : {false, true})
+    for (size_t size : sizes)
+    {
+      const DungeonData dd = open ? gen_open_dungeon(size, size) : gen_bench_dungeon(size, size, 42u);
+      const std::vector<float> sources = gen_sources(dd, 4, 1337u);
+      const size_t reps = std::max(size_t(1), size_t(200000) / (size * size));
+
+      std::vector<float> scanMap;
+      const double scanMs = measure_ms(size == 2048 ? 1 : reps, [&]()
+      {
+        scanMap = sources;
+        dmaps::process_dmap_scan(scanMap, dd);
+      });
+      std::vector<float> queueMap;
+      const double queueMs = measure_ms(reps, [&]()
+      {
+        queueMap = sources;
+        dmaps::process_dmap(queueMap, dd, scratch, DE_QUEUE);
+      });
+      std::vector<float> rasterMap;
+      const double rasterMs = measure_ms(reps, [&]()
+      {
+        rasterMap = sources;
+        dmaps::process_dmap(rasterMap, dd, scratch, DE_RASTER);
+      });
+      const size_t numFloor = size_t(std::count(dd.tiles.begin(), dd.tiles.end(), dungeon::floor));
+      const size_t bytes = scanMap.size() * sizeof(float);
+      const bool match = memcmp(scanMap.data(), queueMap.data(), bytes) == 0 &&
+                         memcmp(scanMap.data(), rasterMap.data(), bytes) == 0;
+      printf("%6s %8zu %10zu %12.3f %12.3f %12.3f %9.1fx %8s\n", open ? "open" : "cave", size, numFloor, scanMs,
+             queueMs, rasterMs, scanMs / std::min(queueMs, rasterMs), match ? "yes" : "NO");
+    }
+
+  // flee map rebuilt from an approach map: separate scaling and relaxation vs the fused generator
+  printf("\n%6s %8s %12s %12s %10s %8s\n", "map", "size", "flee, ms", "fused, ms", "speedup", "match");
+  for (bool open : {false, true})
+    for (size_t size : sizes)
+    {
+      const DungeonData dd = open ? gen_open_dungeon(size, size) : gen_bench_dungeon(size, size, 42u);
+      std::vector<float> approach = gen_sources(dd, 4, 1337u);
+      dmaps::process_dmap(approach, dd, scratch);
+      const size_t reps = std::max(size_t(1), size_t(200000) / (size * size));
+
+      DijkstraMapData flee;
+      flee.engine = DE_QUEUE;
+      const double fleeMs = measure_ms(reps, [&]()
+      {
+        flee.sources.resize(approach.size());
+        for (size_t i = 0; i < approach.size(); ++i)
+          flee.sources[i] = dmaps::scaled_source_value(approach[i], -1.2f);
+        dmaps::rebuild_dmap(flee, dd, scratch);
+      });
+      DijkstraMapData fused;
+      const double fusedMs = measure_ms(reps, [&]()
+      {
+        dmaps::rebuild_scaled_dmap(fused, dd, approach, -1.2f, scratch);
+      });
+      const bool match = memcmp(flee.map.data(), fused.map.data(), flee.map.size() * sizeof(float)) == 0;
+      printf("%6s %8zu %12.3f %12.3f %9.1fx %8s\n", open ? "open" : "cave", size, fleeMs, fusedMs,
+             fleeMs / fusedMs, match ? "yes" : "NO");
+    }
+
+  // a pack of monsters moving around a large dungeon, tracked by a whole dungeon map and a local one
+  printf("\n%6s %8s %8s %14s %14s %14s %14s %8s\n", "map", "size", "radius", "full, ms", "local, ms",
+         "full, bytes", "local, bytes", "match");
+  for (bool open : {false, true})
+  {
+    const size_t size = 1000;
+    const size_t radius = 8;
+    const DungeonData dd = open ? gen_open_dungeon(size, size) : gen_bench_dungeon(size, size, 42u);
+    std::vector<DmapSource> pack;
+    std::mt19937 rng(7u);
+    const size_t center = size_t(std::find(dd.tiles.begin() + long(dd.tiles.size() / 2), dd.tiles.end(),
+                                           dungeon::floor) - dd.tiles.begin());
+    pack.push_back(DmapSource{center, 0.f});
+    for (size_t i = 1; i < 6; ++i)
+    {
+      const size_t idx = center + (rng() % 5) * size + rng() % 5;
+      if (dd.tiles[idx] == dungeon::floor)
+        pack.push_back(DmapSource{idx, 0.f});
+    }
+    // every rep moves one member of the pack back and forth
+    auto step_pack = [&](size_t rep)
+    {
+      DmapSource &member = pack[rep % pack.size()];
+      const size_t next = (rep / pack.size()) % 2 == 0 ? member.idx + 1 : member.idx - 1;
+      if (dd.tiles[next] == dungeon::floor)
+        member.idx = next;
+    };
+    auto run = [&](DijkstraMapData &dmap)
+    {
+      std::vector<DmapSource> sources;
+      size_t rep = 0;
+      return measure_ms(100, [&]()
+      {
+        step_pack(rep++);
+        sources = pack;
+        dmaps::update_dmap_sources(dmap, dd, sources, scratch);
+      });
+    };
+    DijkstraMapData full;
+    DijkstraMapData local;
+    local.radius = radius;
+    const std::vector<DmapSource> startPack = pack;
+    const double fullMs = run(full);
+    pack = startPack;
+    const double localMs = run(local);
+    auto memory = [](const DijkstraMapData &dmap)
+    {
+      return (dmap.map.capacity() + dmap.sources.capacity()) * sizeof(float) +
+             dmap.sourceList.capacity() * sizeof(DmapSource) + dmap.changedTiles.capacity() * sizeof(size_t);
+    };
+    bool match = true;
+    for (size_t y = 0; y < size; ++y)
+      for (size_t x = 0; x < size; ++x)
+      {
+        const float v = dmaps::get_dmap_at(full, x, y);
+        const float expected = v <= float(radius) ? v : dmaps::invalid_tile_value;
+        match = match && dmaps::get_dmap_at(local, x, y) == expected;
+      }
+    printf("%6s %8zu %8zu %14.3f %14.3f %14zu %14zu %8s\n", open ? "open" : "cave", size, radius, fullMs, localMs,
+           memory(full), memory(local), match ? "yes" : "NO");
+  }
+
+  // approach, hive and flee maps read by many followers at random spots, float maps vs packed ones
+  printf("\n%6s %8s %10s %12s %12s %12s %12s %14s %14s %10s\n", "map", "size", "followers", "float, ms",
+         "packed, ms", "field, ms", "packed, ms", "float, bytes", "packed, bytes", "max error");
+  for (bool open : {false, true})
+  {
+    const size_t size = 2048;
+    const DungeonData dd = open ? gen_open_dungeon(size, size) : gen_bench_dungeon(size, size, 42u);
+    DijkstraMapData maps[2][3];
+    for (size_t packed = 0; packed < 2; ++packed)
+    {
+      std::vector<DmapSource> player = gen_sources_list(dd, 1, 1337u);
+      std::vector<DmapSource> hive = gen_sources_list(dd, 8, 7u);
+      maps[packed][0].format = packed ? DF_STEPS : DF_FLOAT;
+      maps[packed][1].format = packed ? DF_STEPS : DF_FLOAT;
+      maps[packed][2].format = packed ? DF_FIXED : DF_FLOAT;
+      dmaps::update_dmap_sources(maps[packed][0], dd, player, scratch);
+      dmaps::update_dmap_sources(maps[packed][1], dd, hive, scratch);
+      dmaps::rebuild_scaled_dmap(maps[packed][2], dd, maps[packed][0].map, -1.2f, scratch);
+    }
+    const std::vector<DmapSource> followers = gen_sources_list(dd, 100000, 99u);
+    std::vector<float> results[2];
+    double ms[2];
+    double fieldMs[2];
+    std::vector<float> field(dd.tiles.size());
+    size_t bytes[2] = {0, 0};
+    for (size_t packed = 0; packed < 2; ++packed)
+    {
+      results[packed].resize(followers.size());
+      ms[packed] = measure_ms(10, [&]()
+      {
+        for (size_t i = 0; i < followers.size(); ++i)
+          results[packed][i] = 0.f;
+        for (const DijkstraMapData &dmap : maps[packed])
+          dmaps::with_dmap_format(dmap, [&](auto format)
+          {
+            for (size_t i = 0; i < followers.size(); ++i)
+            {
+              const size_t x = followers[i].idx % dd.width;
+              const size_t y = followers[i].idx / dd.width;
+              const size_t around[5][2] = {{x, y}, {x - 1, y}, {x + 1, y}, {x, y - 1}, {x, y + 1}};
+              for (const auto &pos : around)
+              {
+                const float v = dmaps::get_dmap_value<decltype(format)::value>(dmap, pos[0], pos[1]);
+                results[packed][i] += v < 1e5f ? powf(v, 1.f) : v;
+              }
+            }
+          });
+      });
+      // the combined follower field refresh streams over whole maps instead
+      fieldMs[packed] = measure_ms(5, [&]()
+      {
+        std::fill(field.begin(), field.end(), 0.f);
+        for (const DijkstraMapData &dmap : maps[packed])
+          dmaps::with_dmap_format(dmap, [&](auto format)
+          {
+            for (size_t y = 0; y < dd.height; ++y)
+              for (size_t x = 0; x < dd.width; ++x)
+              {
+                const float v = dmaps::get_dmap_value<decltype(format)::value>(dmap, x, y);
+                field[y * dd.width + x] += v < 1e5f ? powf(v, 1.f) : v;
+              }
+          });
+      });
+      for (const DijkstraMapData &dmap : maps[packed])
+        bytes[packed] += packed ? dmap.packed.size() * sizeof(uint16_t) : dmap.map.size() * sizeof(float);
+    }
+    float maxError = 0.f;
+    for (size_t i = 0; i < followers.size(); ++i)
+      maxError = std::max(maxError, std::fabs(results[0][i] - results[1][i]));
+    printf("%6s %8zu %10zu %12.3f %12.3f %12.3f %12.3f %14zu %14zu %10.4f\n", open ? "open" : "cave", size,
+           followers.size(), ms[0], ms[1], fieldMs[0], fieldMs[1], bytes[0], bytes[1], double(maxError));
+  }
+
+  // an approach map per faction, sources gathered by a filter pass per map or by one grouped pass
+  printf("\n%6s %8s %8s %10s %14s %14s %14s %14s %8s\n", "map", "size", "teams", "members", "build, ms",
+         "grouped, ms", "turn, ms", "grouped, ms", "match");
+  for (bool open : {false, true})
+  {
+    const size_t size = 512;
+    const size_t numTeams = 32;
+    const DungeonData dd = open ? gen_open_dungeon(size, size) : gen_bench_dungeon(size, size, 42u);
+    const std::vector<DmapSource> start = gen_sources_list(dd, 4000, 11u);
+    auto run = [&](std::vector<DijkstraMapData> &maps, bool grouped)
+    {
+      std::vector<DmapSource> members = start;
+      std::vector<std::vector<DmapSource>> groupSources(numTeams);
+      std::mt19937 rng(5u);
+      maps.assign(numTeams, DijkstraMapData{});
+      auto turn = [&]()
+      {
+        for (size_t i = 0; i < 16; ++i)
+        {
+          DmapSource &member = members[rng() % members.size()];
+          const size_t next = member.idx + (rng() % 2 == 0 ? 1 : dd.width);
+          if (next < dd.tiles.size() && dd.tiles[next] == dungeon::floor)
+            member.idx = next;
+        }
+        for (std::vector<DmapSource> &sources : groupSources)
+          sources.clear();
+        if (grouped)
+          for (size_t i = 0; i < members.size(); ++i)
+            groupSources[i % numTeams].push_back(members[i]);
+        for (size_t team = 0; team < numTeams; ++team)
+        {
+          if (!grouped)
+            for (size_t i = 0; i < members.size(); ++i)
+              if (i % numTeams == team)
+                groupSources[team].push_back(members[i]);
+          dmaps::update_dmap_sources(maps[team], dd, groupSources[team], scratch);
+        }
+      };
+      const double buildMs = measure_ms(1, turn);
+      return std::make_pair(buildMs, measure_ms(20, turn));
+    };
+    std::vector<DijkstraMapData> filtered;
+    std::vector<DijkstraMapData> grouped;
+    const auto filteredMs = run(filtered, false);
+    const auto groupedMs = run(grouped, true);
+    bool match = true;
+    for (size_t team = 0; team < numTeams; ++team)
+      match = match && filtered[team].map == grouped[team].map;
+    printf("%6s %8zu %8zu %10zu %14.3f %14.3f %14.3f %14.3f %8s\n", open ? "open" : "cave", size, numTeams,
+           start.size(), filteredMs.first, groupedMs.first, filteredMs.second, groupedMs.second, match ? "yes" : "NO");
+  }
+  return 0;
+}
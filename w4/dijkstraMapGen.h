@@ -1,11 +1,53 @@
 #pragma once
 #include <vector>
 #include <flecs.h>
+#include "ecsTypes.h"
 
 namespace dmaps
 {
-  void gen_player_approach_map(flecs::world &ecs, std::vector<float> &map);
-  void gen_player_flee_map(flecs::world &ecs, std::vector<float> &map);
-  void gen_hive_pack_map(flecs::world &ecs, std::vector<float> &map);
-};
+  // adds a map to the registry and a named entity referring to it, returns the existing handle
+  // if the name is already taken; a non zero radius makes a local map
+  DmapHandle register_map(flecs::world &ecs, const char *name, size_t radius = 0, DmapFormat format = DF_FLOAT);
+  // returns invalid_dmap_handle for unknown names
+  DmapHandle find_map(flecs::world &ecs, const char *name);
+  // resolves weight names to handles and finds or creates the combined field for them
+  void resolve_weights(flecs::world &ecs, DmapWeights &wt);
+  // marks maps referenced by followers or visualised directly, dependencies are up to the caller
+  void mark_demanded_maps(flecs::world &ecs, DmapRegistry &reg);
+
+  // group_sources[i] is the new source set of the map handles[i], only demanded maps are updated;
+  // the vectors get the previous source lists back, so their capacity is reused between turns
+  void update_group_maps(DmapRegistry &reg, const DungeonData &dd, const std::vector<DmapHandle> &handles,
+                         std::vector<std::vector<DmapSource>> &group_sources);
 
+  // one map per group of the entities matched by `query`, every entity is visited once and group_of
+  // turns its other components into an index into `handles`, negative for entities which aren't sources
+  template<typename... Components, typename GroupOf>
+  void gen_group_maps(flecs::world &ecs, const flecs::query<const Position, Components...> &query,
+                      DmapRegistry &reg, const std::vector<DmapHandle> &handles, GroupOf group_of)
+  {
+    static auto dungeonDataQuery = ecs.query<const DungeonData>();
+    std::vector<std::vector<DmapSource>> &groupSources = reg.scratch.groupSources;
+    dungeonDataQuery.each([&](const DungeonData &dd)
+    {
+      groupSources.resize(handles.size());
+      for (std::vector<DmapSource> &sources : groupSources)
+        sources.clear();
+      query.each([&](const Position &pos, Components &... comps)
+      {
+        const int group = group_of(comps...);
+        if (group >= 0 && size_t(group) < handles.size())
+          groupSources[size_t(group)].push_back(DmapSource{size_t(pos.y) * dd.width + size_t(pos.x), 0.f});
+      });
+      update_group_maps(reg, dd, handles, groupSources);
+    });
+  }
+
+  // maps keep their state between turns and are only repaired around sources which moved,
+  // appeared or disappeared since the previous call;
+  // team_maps[team] is the map leading to members of that team, invalid_dmap_handle skips the team
+  void gen_team_approach_maps(flecs::world &ecs, DmapRegistry &reg, const std::vector<DmapHandle> &team_maps);
+  // the approach map has to cover the whole dungeon
+  void gen_player_flee_map(flecs::world &ecs, DmapRegistry &reg, DmapHandle flee_handle, DmapHandle approach_handle);
+  void gen_hive_pack_map(flecs::world &ecs, DmapRegistry &reg, DmapHandle handle);
+};
@@ -0,0 +1,668 @@
+#include "dmapEngine.h"
+#include "dungeonUtils.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+void dmaps::init_tiles(std::vector<float> &map, const DungeonData &dd)
+{
+  map.assign(dd.width * dd.height, invalid_tile_value);
+}
+
+template<typename Callable>
+static void for_each_floor_neighbour(const DungeonData &dd, size_t idx, Callable c)
+{
+  const size_t x = idx % dd.width;
+  const size_t y = idx / dd.width;
+  if (x > 0 && dd.tiles[idx - 1] == dungeon::floor)
+    c(idx - 1);
+  if (x + 1 < dd.width && dd.tiles[idx + 1] == dungeon::floor)
+    c(idx + 1);
+  if (y > 0 && dd.tiles[idx - dd.width] == dungeon::floor)
+    c(idx - dd.width);
+  if (y + 1 < dd.height && dd.tiles[idx + dd.width] == dungeon::floor)
+    c(idx + dd.width);
+}
+
+// Sources are consumed in order of their value and merged with a FIFO of relaxed tiles.
+// Each step costs exactly 1, so the FIFO stays sorted and every tile is settled once.
+// On return `queue` holds every tile which was lowered by the relaxation.
+static void propagate(std::vector<float> &map, const DungeonData &dd, std::vector<DmapSource> &sources,
+                      std::vector<size_t> &queue, float max_value = dmaps::invalid_tile_value)
+{
+  auto byValue = [](const DmapSource &lhs, const DmapSource &rhs) { return lhs.value < rhs.value; };
+  // approach-like maps have all sources at 0 and skip the sort
+  if (!std::is_sorted(sources.begin(), sources.end(), byValue))
+    std::stable_sort(sources.begin(), sources.end(), byValue);
+
+  queue.clear();
+  auto relax = [&](size_t idx)
+  {
+    const float val = map[idx];
+    const float nextVal = val + 1.f;
+    for_each_floor_neighbour(dd, idx, [&](size_t nidx)
+    {
+      // same check as the old sweep, plus skipping updates which round to the same value
+      if (!(val < map[nidx] - 1.f) || !(nextVal < map[nidx]) || nextVal > max_value)
+        return;
+      map[nidx] = nextVal;
+      queue.push_back(nidx);
+    });
+  };
+
+  size_t nextSource = 0;
+  size_t head = 0;
+  while (nextSource < sources.size() || head < queue.size())
+  {
+    const bool takeSource = nextSource < sources.size() &&
+                            (head == queue.size() || sources[nextSource].value <= map[queue[head]]);
+    if (takeSource)
+    {
+      const DmapSource &src = sources[nextSource++];
+      if (!(map[src.idx] < src.value)) // otherwise it was already reached from a better source
+        relax(src.idx);
+    }
+    else
+      relax(queue[head++]);
+  }
+}
+
+// Vertical relaxation of a whole row from its neighbour row, `mask` is set where both tiles are floor.
+// Uses the same update rule as the queue engine, so both converge to the same values.
+static bool relax_row_from(float *row, const float *nei, const uint32_t *mask, size_t w)
+{
+  size_t x = 0;
+  int changedLanes = 0;
+#if defined(__AVX2__)
+  const __m256 one = _mm256_set1_ps(1.f);
+  for (; x + 8 <= w; x += 8)
+  {
+    const __m256 cur = _mm256_loadu_ps(row + x);
+    const __m256 from = _mm256_loadu_ps(nei + x);
+    const __m256 next = _mm256_add_ps(from, one);
+    __m256 upd = _mm256_and_ps(_mm256_cmp_ps(from, _mm256_sub_ps(cur, one), _CMP_LT_OQ),
+                               _mm256_cmp_ps(next, cur, _CMP_LT_OQ));
+    upd = _mm256_and_ps(upd, _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(mask + x))));
+    changedLanes |= _mm256_movemask_ps(upd);
+    _mm256_storeu_ps(row + x, _mm256_blendv_ps(cur, next, upd));
+  }
+#elif defined(__SSE2__)
+  const __m128 one = _mm_set1_ps(1.f);
+  for (; x + 4 <= w; x += 4)
+  {
+    const __m128 cur = _mm_loadu_ps(row + x);
+    const __m128 from = _mm_loadu_ps(nei + x);
+    const __m128 next = _mm_add_ps(from, one);
+    __m128 upd = _mm_and_ps(_mm_cmplt_ps(from, _mm_sub_ps(cur, one)), _mm_cmplt_ps(next, cur));
+    upd = _mm_and_ps(upd, _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(mask + x))));
+    changedLanes |= _mm_movemask_ps(upd);
+    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(upd, next), _mm_andnot_ps(upd, cur)));
+  }
+#endif
+  bool changed = changedLanes != 0;
+  for (; x < w; ++x)
+  {
+    const float next = nei[x] + 1.f;
+    if (mask[x] && nei[x] < row[x] - 1.f && next < row[x])
+    {
+      row[x] = next;
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+// horizontal dependency is sequential, so rows are swept both ways in scalar code
+static bool relax_row_horizontal(float *row, const char *tiles, size_t w)
+{
+  bool changed = false;
+  auto relax = [&](size_t to, size_t from)
+  {
+    const float next = row[from] + 1.f;
+    if (tiles[to] == dungeon::floor && tiles[from] == dungeon::floor &&
+        row[from] < row[to] - 1.f && next < row[to])
+    {
+      row[to] = next;
+      changed = true;
+    }
+  };
+  for (size_t x = 1; x < w; ++x)
+    relax(x, x - 1);
+  for (size_t x = w - 1; x-- > 0;)
+    relax(x, x + 1);
+  return changed;
+}
+
+// Forward and backward raster passes repeated until nothing changes. Every pass is a streaming
+// walk over the rows, rows are versioned so that relaxations whose inputs didn't change are skipped.
+static void process_dmap_raster(std::vector<float> &map, const DungeonData &dd, DmapScratch &scratch)
+{
+  const size_t w = dd.width;
+  const size_t h = dd.height;
+  // scratch is shared by every map built in a turn, so batches of maps don't reallocate it
+  std::vector<uint32_t> &vertMask = scratch.vertMask;
+  std::vector<uint32_t> &rowVer = scratch.rowVer;
+  std::vector<uint32_t> &horzSeen = scratch.horzSeen;
+  std::vector<uint32_t> &downSeen = scratch.downSeen;
+  std::vector<uint32_t> &upSeen = scratch.upSeen;
+  // row y has the mask against row y - 1
+  vertMask.assign(w * h, 0u);
+  for (size_t i = w; i < w * h; ++i)
+    if (dd.tiles[i] == dungeon::floor && dd.tiles[i - w] == dungeon::floor)
+      vertMask[i] = ~0u;
+
+  // rows without any value yet are consistent as they are
+  rowVer.assign(h, 0u);
+  for (size_t y = 0; y < h; ++y)
+    for (size_t x = 0; x < w && rowVer[y] == 0u; ++x)
+      if (map[y * w + x] < dmaps::invalid_tile_value)
+        rowVer[y] = 1u;
+  // versions of the input rows at the time of the last relaxation
+  horzSeen.assign(h, 0u);
+  downSeen.assign(h, 0u); // row y from row y - 1
+  upSeen.assign(h, 0u); // row y from row y + 1
+
+  auto relaxRow = [&](size_t y)
+  {
+    bool changed = false;
+    if (horzSeen[y] != rowVer[y])
+    {
+      if (relax_row_horizontal(&map[y * w], &dd.tiles[y * w], w))
+      {
+        rowVer[y]++;
+        changed = true;
+      }
+      horzSeen[y] = rowVer[y];
+    }
+    return changed;
+  };
+
+  bool changed = true;
+  while (changed)
+  {
+    changed = false;
+    for (size_t y = 0; y < h; ++y)
+    {
+      if (y > 0 && downSeen[y] != rowVer[y - 1])
+      {
+        downSeen[y] = rowVer[y - 1];
+        if (relax_row_from(&map[y * w], &map[(y - 1) * w], &vertMask[y * w], w))
+        {
+          rowVer[y]++;
+          changed = true;
+        }
+      }
+      changed |= relaxRow(y);
+    }
+    for (size_t y = h; y-- > 0;)
+    {
+      if (y + 1 < h && upSeen[y] != rowVer[y + 1])
+      {
+        upSeen[y] = rowVer[y + 1];
+        if (relax_row_from(&map[y * w], &map[(y + 1) * w], &vertMask[(y + 1) * w], w))
+        {
+          rowVer[y]++;
+          changed = true;
+        }
+      }
+      changed |= relaxRow(y);
+    }
+  }
+}
+
+static void process_dmap_queue(std::vector<float> &map, const DungeonData &dd, DmapScratch &scratch)
+{
+  std::vector<DmapSource> &sources = scratch.seeds;
+  std::vector<size_t> &queue = scratch.queue;
+  sources.clear();
+  for (size_t i = 0; i < map.size(); ++i)
+    if (map[i] < dmaps::invalid_tile_value && dd.tiles[i] == dungeon::floor)
+      sources.push_back(DmapSource{i, map[i]});
+  queue.reserve(map.size());
+  propagate(map, dd, sources, queue);
+}
+
+DmapEngine dmaps::select_engine(const DungeonData &dd)
+{
+  const size_t numTiles = dd.width * dd.height;
+  const size_t numFloor = size_t(std::count(dd.tiles.begin(), dd.tiles.end(), dungeon::floor));
+  // open maps converge in a couple of raster passes, corridors need one per turn of the path
+  return dd.width >= 16 && numFloor * 100 >= numTiles * raster_min_floor_percent ? DE_RASTER : DE_QUEUE;
+}
+
+void dmaps::process_dmap(std::vector<float> &map, const DungeonData &dd, DmapScratch &scratch, DmapEngine engine)
+{
+  if (engine == DE_AUTO)
+    engine = select_engine(dd);
+  if (engine == DE_RASTER)
+    process_dmap_raster(map, dd, scratch);
+  else
+    process_dmap_queue(map, dd, scratch);
+}
+
+static uint16_t pack_value(const DijkstraMapData &dmap, float v)
+{
+  if (!(v < dmaps::invalid_tile_value))
+    return dmaps::invalid_packed_value;
+  const float q = dmap.format == DF_STEPS ? std::round(v) : std::round((v - dmap.packedOffset) / dmap.packedScale);
+  return uint16_t(std::clamp(q, 0.f, float(dmaps::invalid_packed_value - 1)));
+}
+
+// Refreshes the packed copy after an update, only at the changed tiles if possible. Fixed point maps
+// keep their scale until a value doesn't fit, then every value moves and the map is reported as rebuilt.
+static void pack_dmap(DijkstraMapData &dmap, const DungeonData &dd)
+{
+  if (dmap.format == DF_FLOAT)
+  {
+    dmap.packed.clear();
+    return;
+  }
+  // local map windows move, they are small enough to be always repacked
+  bool full = dmap.rebuilt || dmap.radius > 0 || dmap.packed.size() != dmap.map.size();
+  if (dmap.format == DF_FIXED)
+  {
+    const float maxPacked = float(dmaps::invalid_packed_value - 1);
+    auto fits = [&](float v)
+    {
+      return !(v < dmaps::invalid_tile_value) ||
+             (dmap.packedScale > 0.f && v >= dmap.packedOffset && v <= dmap.packedOffset + maxPacked * dmap.packedScale);
+    };
+    bool rescale = false;
+    if (full)
+      for (float v : dmap.map)
+        rescale = rescale || !fits(v);
+    else
+      for (size_t idx : dmap.changedTiles)
+        rescale = rescale || !fits(dmaps::get_dmap_value<DF_FLOAT>(dmap, idx % dd.width, idx / dd.width));
+    if (rescale)
+    {
+      // the finest power of two step which covers the value range
+      float minValue = dmaps::invalid_tile_value;
+      float maxValue = -dmaps::invalid_tile_value;
+      for (float v : dmap.map)
+        if (v < dmaps::invalid_tile_value)
+        {
+          minValue = std::min(minValue, v);
+          maxValue = std::max(maxValue, v);
+        }
+      dmap.packedOffset = std::floor(minValue);
+      dmap.packedScale = 1.f / 1024.f;
+      while (dmap.packedOffset + maxPacked * dmap.packedScale < maxValue)
+        dmap.packedScale *= 2.f;
+      full = true;
+      if (!dmap.rebuilt)
+      {
+        dmap.rebuilt = true;
+        dmap.changedTiles.clear();
+      }
+    }
+  }
+  if (!full)
+  {
+    for (size_t idx : dmap.changedTiles)
+    {
+      const size_t wx = idx % dd.width - dmap.winX;
+      const size_t wy = idx / dd.width - dmap.winY;
+      dmap.packed[wy * dmap.winWidth + wx] = pack_value(dmap, dmap.map[wy * dmap.winWidth + wx]);
+    }
+    return;
+  }
+  dmap.packed.resize(dmap.map.size());
+  for (size_t i = 0; i < dmap.map.size(); ++i)
+    dmap.packed[i] = pack_value(dmap, dmap.map[i]);
+}
+
+static void set_full_window(DijkstraMapData &dmap, const DungeonData &dd)
+{
+  dmap.winX = 0;
+  dmap.winY = 0;
+  dmap.winWidth = dd.width;
+  dmap.winHeight = dd.height;
+}
+
+void dmaps::rebuild_dmap(DijkstraMapData &dmap, const DungeonData &dd, DmapScratch &scratch)
+{
+  dmap.sources.resize(dd.width * dd.height, invalid_tile_value);
+  dmap.map = dmap.sources;
+  set_full_window(dmap, dd);
+  process_dmap(dmap.map, dd, scratch, dmap.engine);
+  dmap.changedTiles.clear();
+  dmap.rebuilt = true;
+  pack_dmap(dmap, dd);
+  dmap.version++;
+  dmap.numRebuilds++;
+}
+
+void dmaps::rebuild_scaled_dmap(DijkstraMapData &dmap, const DungeonData &dd, const std::vector<float> &field,
+                                float scale, DmapScratch &scratch)
+{
+  std::vector<DmapSource> &order = scratch.seeds;
+  std::vector<size_t> &counts = scratch.counts;
+  const size_t numTiles = dd.width * dd.height;
+  dmap.sources.resize(numTiles);
+  dmap.map.resize(numTiles);
+  bool integral = scale < 0.f;
+  float maxValue = 0.f;
+  for (size_t i = 0; i < numTiles; ++i)
+  {
+    const float v = field[i];
+    const float scaled = scaled_source_value(v, scale);
+    dmap.sources[i] = scaled;
+    dmap.map[i] = scaled;
+    if (v < invalid_tile_value && dd.tiles[i] == dungeon::floor)
+    {
+      integral = integral && v >= 0.f && v == float(size_t(v));
+      maxValue = std::max(maxValue, v);
+    }
+  }
+
+  order.clear();
+  if (integral)
+  {
+    // the scale is negative, so the largest field values are the lowest sources
+    const size_t maxDist = size_t(maxValue);
+    counts.assign(maxDist + 2, 0);
+    for (size_t i = 0; i < numTiles; ++i)
+      if (field[i] < invalid_tile_value && dd.tiles[i] == dungeon::floor)
+        counts[maxDist - size_t(field[i]) + 1]++;
+    for (size_t d = 1; d < counts.size(); ++d)
+      counts[d] += counts[d - 1];
+    order.resize(counts.back());
+    for (size_t i = 0; i < numTiles; ++i)
+      if (field[i] < invalid_tile_value && dd.tiles[i] == dungeon::floor)
+        order[counts[maxDist - size_t(field[i])]++] = DmapSource{i, dmap.sources[i]};
+  }
+  else
+  {
+    for (size_t i = 0; i < numTiles; ++i)
+      if (dmap.sources[i] < invalid_tile_value && dd.tiles[i] == dungeon::floor)
+        order.push_back(DmapSource{i, dmap.sources[i]});
+  }
+  set_full_window(dmap, dd);
+  propagate(dmap.map, dd, order, scratch.queue);
+  dmap.changedTiles.clear();
+  dmap.rebuilt = true;
+  pack_dmap(dmap, dd);
+  dmap.version++;
+  dmap.numRebuilds++;
+}
+
+// Raising or removing a source invalidates every tile whose value was derived from it,
+// the hole is then refilled from its border together with any lowered sources.
+bool dmaps::repair_dmap(DijkstraMapData &dmap, const DungeonData &dd, const std::vector<DmapSource> &changes,
+                        DmapScratch &scratch)
+{
+  std::vector<float> &map = dmap.map;
+  std::vector<float> &sources = dmap.sources;
+  if (map.size() != dd.width * dd.height || sources.size() != map.size())
+  {
+    sources.assign(dd.width * dd.height, invalid_tile_value);
+    for (const DmapSource &change : changes)
+      sources[change.idx] = change.value;
+    rebuild_dmap(dmap, dd, scratch);
+    return false;
+  }
+  // nothing moved, the map and its last changes stay as they are
+  if (changes.empty())
+  {
+    dmap.numReuses++;
+    return true;
+  }
+
+  // scratch buffers keep their capacity between repairs
+  std::vector<DmapSource> &invalidated = scratch.invalidated;
+  std::vector<DmapSource> &seeds = scratch.seeds;
+  std::vector<size_t> &lowered = scratch.queue;
+  std::vector<size_t> &unchanged = scratch.unchanged;
+  invalidated.clear();
+  seeds.clear();
+  unchanged.clear();
+  for (const DmapSource &change : changes)
+  {
+    const float prevSource = sources[change.idx];
+    sources[change.idx] = change.value;
+    const bool ownSource = map[change.idx] == prevSource && prevSource < invalid_tile_value;
+    if (dd.tiles[change.idx] == dungeon::floor && ownSource && change.value > prevSource)
+    {
+      invalidated.push_back(DmapSource{change.idx, map[change.idx]});
+      map[change.idx] = invalid_tile_value;
+    }
+  }
+  const size_t maxInvalidated = map.size() / 4;
+  for (size_t head = 0; head < invalidated.size(); ++head)
+  {
+    const DmapSource cur = invalidated[head];
+    for_each_floor_neighbour(dd, cur.idx, [&](size_t nidx)
+    {
+      const float val = map[nidx];
+      if (val < invalid_tile_value && val == cur.value + 1.f && sources[nidx] != val)
+      {
+        invalidated.push_back(DmapSource{nidx, val});
+        map[nidx] = invalid_tile_value;
+      }
+    });
+    if (invalidated.size() > maxInvalidated)
+    {
+      rebuild_dmap(dmap, dd, scratch);
+      return false;
+    }
+  }
+
+  // lowered sources and tiles lowered by the relaxation always change,
+  // refilled ones might get their old value back
+  std::vector<size_t> &changed = dmap.changedTiles;
+  changed.clear();
+  for (const DmapSource &change : changes)
+    if (dd.tiles[change.idx] == dungeon::floor && change.value < map[change.idx])
+    {
+      map[change.idx] = change.value;
+      seeds.push_back(change);
+      changed.push_back(change.idx);
+    }
+  for (const DmapSource &inv : invalidated)
+  {
+    if (sources[inv.idx] < map[inv.idx])
+    {
+      map[inv.idx] = sources[inv.idx];
+      seeds.push_back(DmapSource{inv.idx, map[inv.idx]});
+    }
+    for_each_floor_neighbour(dd, inv.idx, [&](size_t nidx)
+    {
+      if (map[nidx] < invalid_tile_value)
+        seeds.push_back(DmapSource{nidx, map[nidx]});
+    });
+  }
+  propagate(map, dd, seeds, lowered);
+
+  changed.insert(changed.end(), lowered.begin(), lowered.end());
+  for (const DmapSource &inv : invalidated)
+    if (map[inv.idx] == inv.value)
+      unchanged.push_back(inv.idx);
+    else
+      changed.push_back(inv.idx);
+  std::sort(changed.begin(), changed.end());
+  changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+  std::sort(unchanged.begin(), unchanged.end());
+  changed.erase(std::remove_if(changed.begin(), changed.end(), [&](size_t idx)
+  {
+    return std::binary_search(unchanged.begin(), unchanged.end(), idx);
+  }), changed.end());
+  dmap.rebuilt = false;
+  pack_dmap(dmap, dd);
+  dmap.version++;
+  dmap.numRepairs++;
+  return true;
+}
+
+// The window is the bounding box of the sources grown by the radius, every tile within radius steps
+// of a source lies inside it, so the values there match a whole dungeon map.
+static void rebuild_local_dmap(DijkstraMapData &dmap, const DungeonData &dd, DmapScratch &scratch)
+{
+  DungeonData &window = scratch.window;
+  std::vector<float> &prevMap = scratch.prevMap;
+  std::vector<DmapSource> &seeds = scratch.seeds;
+
+  prevMap.swap(dmap.map);
+  const size_t prevX = dmap.winX;
+  const size_t prevY = dmap.winY;
+  const size_t prevWidth = dmap.winWidth;
+  const size_t prevHeight = dmap.winHeight;
+  size_t minX = dd.width;
+  size_t minY = dd.height;
+  size_t maxX = 0;
+  size_t maxY = 0;
+  float minValue = dmaps::invalid_tile_value;
+  for (const DmapSource &src : dmap.sourceList)
+  {
+    if (dd.tiles[src.idx] != dungeon::floor)
+      continue;
+    minX = std::min(minX, src.idx % dd.width);
+    minY = std::min(minY, src.idx / dd.width);
+    maxX = std::max(maxX, src.idx % dd.width);
+    maxY = std::max(maxY, src.idx / dd.width);
+    minValue = std::min(minValue, src.value);
+  }
+  dmap.map.clear();
+  dmap.winWidth = 0;
+  dmap.winHeight = 0;
+  if (minX <= maxX)
+  {
+    const size_t r = dmap.radius;
+    dmap.winX = minX > r ? minX - r : 0;
+    dmap.winY = minY > r ? minY - r : 0;
+    dmap.winWidth = std::min(maxX + r + 1, dd.width) - dmap.winX;
+    dmap.winHeight = std::min(maxY + r + 1, dd.height) - dmap.winY;
+    window.width = dmap.winWidth;
+    window.height = dmap.winHeight;
+    window.tiles.resize(window.width * window.height);
+    for (size_t y = 0; y < window.height; ++y)
+    {
+      const auto row = dd.tiles.begin() + long((dmap.winY + y) * dd.width + dmap.winX);
+      std::copy(row, row + long(window.width), window.tiles.begin() + long(y * window.width));
+    }
+    dmap.map.assign(window.width * window.height, dmaps::invalid_tile_value);
+    seeds.clear();
+    for (const DmapSource &src : dmap.sourceList)
+    {
+      if (dd.tiles[src.idx] != dungeon::floor)
+        continue;
+      const size_t localIdx = (src.idx / dd.width - dmap.winY) * window.width + src.idx % dd.width - dmap.winX;
+      dmap.map[localIdx] = std::min(dmap.map[localIdx], src.value);
+      seeds.push_back(DmapSource{localIdx, src.value});
+    }
+    propagate(dmap.map, window, seeds, scratch.queue, minValue + float(r));
+  }
+
+  // windows are small, so the exact changes are found by comparing the old and the new one
+  auto prevAt = [&](size_t x, size_t y)
+  {
+    if (x - prevX >= prevWidth || y - prevY >= prevHeight)
+      return dmaps::invalid_tile_value;
+    return prevMap[(y - prevY) * prevWidth + x - prevX];
+  };
+  std::vector<size_t> &changed = dmap.changedTiles;
+  changed.clear();
+  for (size_t y = dmap.winY; y < dmap.winY + dmap.winHeight; ++y)
+    for (size_t x = dmap.winX; x < dmap.winX + dmap.winWidth; ++x)
+      if (dmaps::get_dmap_value<DF_FLOAT>(dmap, x, y) != prevAt(x, y))
+        changed.push_back(y * dd.width + x);
+  for (size_t y = prevY; y < prevY + prevHeight; ++y)
+    for (size_t x = prevX; x < prevX + prevWidth; ++x)
+      if (prevAt(x, y) < dmaps::invalid_tile_value && dmaps::get_dmap_value<DF_FLOAT>(dmap, x, y) == dmaps::invalid_tile_value)
+        changed.push_back(y * dd.width + x);
+  std::sort(changed.begin(), changed.end());
+  changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+  // before the first build even tiles outside of the window weren't valid
+  dmap.rebuilt = dmap.version == 0;
+  if (dmap.rebuilt)
+    changed.clear();
+  pack_dmap(dmap, dd);
+  dmap.version++;
+  dmap.numRebuilds++;
+}
+
+bool dmaps::update_dmap_sources(DijkstraMapData &dmap, const DungeonData &dd, std::vector<DmapSource> &sources,
+                                DmapScratch &scratch)
+{
+  // several sources on one tile keep the lowest value
+  std::sort(sources.begin(), sources.end(), [](const DmapSource &lhs, const DmapSource &rhs)
+  {
+    return lhs.idx < rhs.idx || (lhs.idx == rhs.idx && lhs.value < rhs.value);
+  });
+  sources.erase(std::unique(sources.begin(), sources.end(), [](const DmapSource &lhs, const DmapSource &rhs)
+  {
+    return lhs.idx == rhs.idx;
+  }), sources.end());
+
+  std::vector<DmapSource> &changes = scratch.changes;
+  changes.clear();
+  size_t oldIdx = 0;
+  size_t newIdx = 0;
+  const std::vector<DmapSource> &prev = dmap.sourceList;
+  while (oldIdx < prev.size() || newIdx < sources.size())
+  {
+    if (newIdx == sources.size() || (oldIdx < prev.size() && prev[oldIdx].idx < sources[newIdx].idx))
+      changes.push_back(DmapSource{prev[oldIdx++].idx, invalid_tile_value});
+    else if (oldIdx == prev.size() || sources[newIdx].idx < prev[oldIdx].idx)
+      changes.push_back(sources[newIdx++]);
+    else
+    {
+      if (sources[newIdx].value != prev[oldIdx].value)
+        changes.push_back(sources[newIdx]);
+      oldIdx++;
+      newIdx++;
+    }
+  }
+  dmap.sourceList.swap(sources);
+  if (dmap.radius > 0)
+  {
+    if (changes.empty() && dmap.version > 0)
+      dmap.numReuses++;
+    else
+      rebuild_local_dmap(dmap, dd, scratch);
+    return true;
+  }
+  return repair_dmap(dmap, dd, changes, scratch);
+}
+
+void dmaps::process_dmap_scan(std::vector<float> &map, const DungeonData &dd)
+{
+  bool done = false;
+  auto getMapAt = [&](size_t x, size_t y, float def)
+  {
+    if (x < dd.width && y < dd.height && dd.tiles[y * dd.width + x] == dungeon::floor)
+      return map[y * dd.width + x];
+    return def;
+  };
+  auto getMinNei = [&](size_t x, size_t y)
+  {
+    float val = map[y * dd.width + x];
+    val = std::min(val, getMapAt(x - 1, y + 0, val));
+    val = std::min(val, getMapAt(x + 1, y + 0, val));
+    val = std::min(val, getMapAt(x + 0, y - 1, val));
+    val = std::min(val, getMapAt(x + 0, y + 1, val));
+    return val;
+  };
+  while (!done)
+  {
+    done = true;
+    for (size_t y = 0; y < dd.height; ++y)
+      for (size_t x = 0; x < dd.width; ++x)
+      {
+        const size_t i = y * dd.width + x;
+        if (dd.tiles[i] != dungeon::floor)
+          continue;
+        const float myVal = getMapAt(x, y, invalid_tile_value);
+        const float minVal = getMinNei(x, y);
+        if (minVal < myVal - 1.f)
+        {
+          map[i] = minVal + 1.f;
+          done = false;
+        }
+      }
+  }
+}
+
@@ -1,21 +1,31 @@
 #include "dungeonUtils.h"
-#include "raylib.h"
+#include "randomStream.h"
+#include <algorithm>
+
+void dungeon::init_walkable_tiles(DungeonData &dd)
+{
+  dd.walkable.clear();
+  for (size_t y = 0; y < dd.height; ++y)
+    for (size_t x = 0; x < dd.width; ++x)
+      if (dd.tiles[y * dd.width + x] == dungeon::floor)
+        dd.walkable.push_back(Position{int(x), int(y)});
+}
 
 Position dungeon::find_walkable_tile(flecs::world &ecs)
 {
   static auto dungeonDataQuery = ecs.query<const DungeonData>();
+  static auto worldStreamQuery = ecs.query<const WorldSeed, RandomStream>();
 
   Position res{0, 0};
-  dungeonDataQuery.each([&](const DungeonData &dd)
+  worldStreamQuery.each([&](const WorldSeed &, RandomStream &rs)
   {
-    // prebuild all walkable and get one of them
-    std::vector<Position> posList;
-    for (size_t y = 0; y < dd.height; ++y)
-      for (size_t x = 0; x < dd.width; ++x)
-        if (dd.tiles[y * dd.width + x] == dungeon::floor)
-          posList.push_back(Position{int(x), int(y)});
-    size_t rndIdx = size_t(GetRandomValue(0, int(posList.size()) - 1));
-    res = posList[rndIdx];
+    dungeonDataQuery.each([&](const DungeonData &dd)
+    {
+      if (dd.walkable.empty())
+        return;
+      size_t rndIdx = size_t(random_int(rs, 0, int(dd.walkable.size()) - 1));
+      res = dd.walkable[rndIdx];
+    });
   });
   return res;
 }
@@ -35,3 +45,205 @@ bool dungeon::is_tile_walkable(flecs::world &ecs, Position pos)
   return res;
 }
 
+constexpr size_t invalid_free_slot = size_t(-1);
+
+static size_t occupancy_tile(const OccupancyGrid &occ, Position pos)
+{
+  if (pos.x < 0 || size_t(pos.x) >= occ.width || pos.y < 0 || size_t(pos.y) >= occ.height)
+    return invalid_free_slot;
+  return size_t(pos.y) * occ.width + size_t(pos.x);
+}
+
+static void set_occupant(OccupancyGrid &occ, size_t tile, uint64_t e)
+{
+  const bool wasFree = occ.occupants[tile] == 0;
+  occ.occupants[tile] = e;
+  const size_t slot = occ.freeSlots[tile];
+  if (slot == invalid_free_slot || wasFree == (e == 0))
+    return;
+  // swap the tile over the border between free and occupied tiles
+  const size_t border = wasFree ? occ.numFree - 1 : occ.numFree;
+  const size_t other = occ.freeOrder[border];
+  std::swap(occ.freeOrder[slot], occ.freeOrder[border]);
+  occ.freeSlots[other] = slot;
+  occ.freeSlots[tile] = border;
+  occ.numFree = wasFree ? occ.numFree - 1 : occ.numFree + 1;
+}
+
+// frees the tile the entity was indexed under and takes the new one, an invalid tile only frees
+static void place_occupant(OccupancyGrid &occ, uint64_t e, size_t tile)
+{
+  auto it = occ.tiles.find(e);
+  if (it != occ.tiles.end())
+  {
+    if (occ.occupants[it->second] == e)
+      set_occupant(occ, it->second, 0);
+    if (tile == invalid_free_slot)
+      occ.tiles.erase(it);
+    else
+      it->second = tile;
+  }
+  else if (tile != invalid_free_slot)
+    occ.tiles.emplace(e, tile);
+  if (tile != invalid_free_slot)
+    set_occupant(occ, tile, e);
+}
+
+void dungeon::reset_occupancy(flecs::world &ecs, flecs::entity dungeon_entity)
+{
+  auto movePosQuery = ecs.query<const MovePos>();
+
+  OccupancyGrid grid;
+  dungeon_entity.get([&](const DungeonData &dd)
+  {
+    grid.occupants.assign(dd.width * dd.height, 0);
+    grid.width = dd.width;
+    grid.height = dd.height;
+    grid.freeSlots.assign(dd.width * dd.height, invalid_free_slot);
+    for (const Position &pos : dd.walkable)
+    {
+      const size_t tile = occupancy_tile(grid, pos);
+      grid.freeSlots[tile] = grid.freeOrder.size();
+      grid.freeOrder.push_back(tile);
+    }
+    grid.numFree = grid.freeOrder.size();
+  });
+  movePosQuery.each([&](flecs::entity e, const MovePos &mpos)
+  {
+    place_occupant(grid, e.id(), occupancy_tile(grid, Position{mpos.x, mpos.y}));
+  });
+  dungeon_entity.set(std::move(grid));
+}
+
+void dungeon::init_occupancy(flecs::world &ecs, flecs::entity dungeon_entity)
+{
+  reset_occupancy(ecs, dungeon_entity);
+
+  // spawned entities and teleports, regular moves don't go through set
+  ecs.observer<const MovePos>()
+    .event(flecs::OnSet)
+    .each([dungeon_entity](flecs::entity e, const MovePos &mpos)
+    {
+      dungeon_entity.get([&](OccupancyGrid &occ)
+      {
+        place_occupant(occ, e.id(), occupancy_tile(occ, Position{mpos.x, mpos.y}));
+      });
+    });
+  ecs.observer<const MovePos>()
+    .event(flecs::OnRemove)
+    .each([dungeon_entity](flecs::entity e, const MovePos &)
+    {
+      dungeon_entity.get([&](OccupancyGrid &occ)
+      {
+        place_occupant(occ, e.id(), invalid_free_slot);
+      });
+    });
+}
+
+flecs::entity_t dungeon::get_occupant(const OccupancyGrid &occ, Position pos)
+{
+  const size_t tile = occupancy_tile(occ, pos);
+  return tile != invalid_free_slot ? occ.occupants[tile] : 0;
+}
+
+void dungeon::move_occupant(OccupancyGrid &occ, flecs::entity_t e, Position to)
+{
+  place_occupant(occ, e, occupancy_tile(occ, to));
+}
+
+Position dungeon::find_free_tile(flecs::world &ecs)
+{
+  static auto occupancyQuery = ecs.query<const OccupancyGrid>();
+  static auto worldStreamQuery = ecs.query<const WorldSeed, RandomStream>();
+
+  Position res{0, 0};
+  worldStreamQuery.each([&](const WorldSeed &, RandomStream &rs)
+  {
+    occupancyQuery.each([&](const OccupancyGrid &occ)
+    {
+      if (occ.numFree == 0)
+        return;
+      const size_t tile = occ.freeOrder[size_t(random_int(rs, 0, int(occ.numFree) - 1))];
+      res = Position{int(tile % occ.width), int(tile / occ.width)};
+    });
+  });
+  return res;
+}
+
+static void unindex_pickup(PickupIndex &index, uint64_t e)
+{
+  auto tileIt = index.tiles.find(e);
+  if (tileIt == index.tiles.end())
+    return;
+  auto it = index.items.find(tileIt->second);
+  index.tiles.erase(tileIt);
+  if (it == index.items.end())
+    return;
+  it->second.erase(std::remove(it->second.begin(), it->second.end(), e), it->second.end());
+  if (it->second.empty())
+    index.items.erase(it);
+}
+
+// an item set to another position leaves the tile it was indexed under, like occupants do
+static void index_pickup(PickupIndex &index, uint64_t e, const Position &pos)
+{
+  const size_t tile = size_t(pos.y) * index.width + size_t(pos.x);
+  auto tileIt = index.tiles.find(e);
+  if (tileIt != index.tiles.end() && tileIt->second == tile)
+    return;
+  unindex_pickup(index, e);
+  index.tiles.emplace(e, tile);
+  index.items[tile].push_back(e);
+}
+
+template<typename Item>
+static void observe_pickups(flecs::world &ecs, flecs::entity dungeon_entity)
+{
+  ecs.observer<const Position, const Item>()
+    .event(flecs::OnSet)
+    .each([dungeon_entity](flecs::entity e, const Position &pos, const Item &)
+    {
+      dungeon_entity.get([&](PickupIndex &index) { index_pickup(index, e.id(), pos); });
+    });
+  ecs.observer<const Position, const Item>()
+    .event(flecs::OnRemove)
+    .each([dungeon_entity](flecs::entity e, const Position &, const Item &)
+    {
+      dungeon_entity.get([&](PickupIndex &index) { unindex_pickup(index, e.id()); });
+    });
+}
+
+void dungeon::init_pickups(flecs::world &ecs, flecs::entity dungeon_entity)
+{
+  PickupIndex index;
+  dungeon_entity.get([&](const DungeonData &dd) { index.width = dd.width; });
+  auto addItem = [&](flecs::entity e, const Position &pos)
+  {
+    index_pickup(index, e.id(), pos);
+  };
+  ecs.query<const Position, const HealAmount>().each([&](flecs::entity e, const Position &pos, const HealAmount &)
+  {
+    addItem(e, pos);
+  });
+  ecs.query<const Position, const PowerupAmount>().each([&](flecs::entity e, const Position &pos, const PowerupAmount &)
+  {
+    addItem(e, pos);
+  });
+  dungeon_entity.set(std::move(index));
+
+  observe_pickups<HealAmount>(ecs, dungeon_entity);
+  observe_pickups<PowerupAmount>(ecs, dungeon_entity);
+}
+
+void dungeon::take_pickups(PickupIndex &index, Position pos, std::vector<flecs::entity_t> &items)
+{
+  if (pos.x < 0 || pos.y < 0 || size_t(pos.x) >= index.width)
+    return;
+  auto it = index.items.find(size_t(pos.y) * index.width + size_t(pos.x));
+  if (it == index.items.end())
+    return;
+  items.insert(items.end(), it->second.begin(), it->second.end());
+  for (uint64_t item : it->second)
+    index.tiles.erase(item);
+  index.items.erase(it);
+}
@@ -0,0 +1,28 @@
+# ctest check that the AI worker count doesn't change the game: runs the headless game autoplayed with one
+# worker and with WORKERS of them and compares the world checksums; MONSTERS extra monsters give every worker
+# a share of the decisions on every turn
+# cmake -DHEADLESS=<runner> -DTURNS=<turns> -DSEEDS=<seed;seed...> -DWORKERS=<count> -DMONSTERS=<count>
+#       -P checkWorkers.cmake
+
+foreach(seed ${SEEDS})
+  set(checksums "")
+  foreach(workers 1 ${WORKERS})
+    execute_process(COMMAND ${HEADLESS} ${TURNS} ${seed} auto ${workers} - ${MONSTERS}
+                    OUTPUT_VARIABLE output
+                    RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+      message(FATAL_ERROR "${HEADLESS} ${TURNS} ${seed} auto ${workers} - ${MONSTERS} failed: ${result}\n${output}")
+    endif()
+    string(REGEX MATCH "checksum ([0-9a-f]+)" checksum "${output}")
+    if(NOT checksum)
+      message(FATAL_ERROR "no checksum in the output of ${HEADLESS} ${TURNS} ${seed} auto ${workers} - ${MONSTERS}:\n${output}")
+    endif()
+    message(STATUS "seed ${seed}, ${workers} workers: ${CMAKE_MATCH_1}")
+    list(APPEND checksums ${CMAKE_MATCH_1})
+  endforeach()
+  list(REMOVE_DUPLICATES checksums)
+  list(LENGTH checksums numChecksums)
+  if(NOT numChecksums EQUAL 1)
+    message(FATAL_ERROR "seed ${seed}: 1 and ${WORKERS} workers end in different worlds: ${checksums}")
+  endif()
+endforeach()
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+#include "ecsTypes.h"
+
+// splitmix64: a single word of state and a few multiplies per number, plenty for game decisions
+inline uint64_t next_random(RandomStream &rs)
+{
+  uint64_t z = (rs.state += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+// in [min, max] like GetRandomValue
+inline int random_int(RandomStream &rs, int min, int max)
+{
+  const uint64_t range = uint64_t(int64_t(max) - int64_t(min) + 1);
+  return int(int64_t(min) + int64_t(next_random(rs) % range));
+}
+
+// streams of different entities start far apart, so they don't repeat each other
+inline RandomStream make_random_stream(uint64_t world_seed, uint64_t entity_id)
+{
+  RandomStream seeder{world_seed ^ (entity_id * 0xd1b54a32d192ed03ull)};
+  return RandomStream{next_random(seeder)};
+}
+
@@ -0,0 +1,37 @@
+#include "actionLog.h"
+#include <algorithm>
+#include <cstring>
+
+void push_action_log(ActionLog &log, int turn, const char *msg)
+{
+  char *text = log.entries[log.total % log.entries.size()].text;
+  const int len = snprintf(text, ActionLog::entry_size, "%d: %s", turn, msg);
+  const size_t used = std::min(size_t(std::max(len, 0)), ActionLog::entry_size - 1);
+  memset(text + used, ' ', ActionLog::entry_size - 1 - used);
+  text[ActionLog::entry_size - 1] = '\n';
+  log.total++;
+}
+
+const ActionLog::Entry &get_action_log_entry(const ActionLog &log, size_t idx)
+{
+  return log.entries[(log.total - 1 - idx) % log.entries.size()];
+}
+
+size_t write_action_log(const ActionLog &log, FILE *file, size_t &cursor)
+{
+  const size_t ringSize = log.entries.size();
+  const size_t oldest = log.total > ringSize ? log.total - ringSize : 0;
+  const size_t lost = cursor < oldest ? oldest - cursor : 0;
+  size_t from = std::max(cursor, oldest);
+  while (from < log.total)
+  {
+    // up to the end of the ring, then from its start
+    const size_t slot = from % ringSize;
+    const size_t count = std::min(log.total - from, ringSize - slot);
+    fwrite(log.entries[slot].text, ActionLog::entry_size, count, file);
+    from += count;
+  }
+  cursor = log.total;
+  return lost;
+}
+
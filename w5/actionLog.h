@@ -0,0 +1,12 @@
+#pragma once
+#include <cstdio>
+#include "ecsTypes.h"
+
+// formats "turn: msg" right into the next entry, overwriting the oldest one once the ring is full
+void push_action_log(ActionLog &log, int turn, const char *msg);
+// 0 is the newest, only the last min(total, entries.size()) entries are kept
+const ActionLog::Entry &get_action_log_entry(const ActionLog &log, size_t idx);
+// writes the entries pushed since cursor as text lines, in at most two fwrite calls, and moves the cursor;
+// returns the number of entries overwritten before they could be written, call it often enough to keep it 0
+size_t write_action_log(const ActionLog &log, FILE *file, size_t &cursor);
+
@@ -0,0 +1,198 @@
+#include "actorSchedule.h"
+#include "dmapEngine.h"
+#include <algorithm>
+#include <cmath>
+
+static bool is_later(const ActorSchedule::Entry &lhs, const ActorSchedule::Entry &rhs)
+{
+  return lhs.tick != rhs.tick ? lhs.tick > rhs.tick : lhs.id > rhs.id;
+}
+
+static void push_actor(ActorSchedule &sched, int64_t tick, flecs::entity_t id)
+{
+  sched.nextTicks[id] = tick;
+  sched.queue.push_back(ActorSchedule::Entry{tick, id});
+  std::push_heap(sched.queue.begin(), sched.queue.end(), is_later);
+}
+
+static int64_t get_action_delay(flecs::world &ecs, flecs::entity_t id)
+{
+  int delay = 1;
+  flecs::entity(ecs, id).get([&](const ActionDelay &d) { delay = d.ticks; });
+  return std::max(delay, 1);
+}
+
+static size_t chunk_of(const ActivityZone &zone, size_t x, size_t y)
+{
+  return (y / zone.chunkSize) * zone.chunksX + x / zone.chunkSize;
+}
+
+static bool drop_sleeper(std::vector<ActivityZone::Sleeper> &sleepers, flecs::entity_t id)
+{
+  auto it = std::find_if(sleepers.begin(), sleepers.end(), [&](const ActivityZone::Sleeper &s) { return s.id == id; });
+  if (it == sleepers.end())
+    return false;
+  sleepers.erase(it);
+  return true;
+}
+
+void init_actor_schedule(flecs::world &ecs, flecs::entity world_entity)
+{
+  world_entity.set(ActorSchedule{});
+  world_entity.set(ActivityZone{});
+  ecs.observer<const ActionDelay>()
+    .without<IsPlayer>()
+    .event(flecs::OnAdd)
+    .each([world_entity](flecs::entity e, const ActionDelay &delay)
+    {
+      world_entity.get([&](ActorSchedule &sched)
+      {
+        push_actor(sched, sched.now + std::max(delay.ticks, 1), e.id());
+      });
+    });
+  // OnAdd sees the default delay, so sets move the queued actor to its new tick; sleeping ones and the due
+  // ones waiting for requeue_actors pick the delay up when they are queued again
+  ecs.observer<const ActionDelay>()
+    .without<IsPlayer>()
+    .event(flecs::OnSet)
+    .each([world_entity](flecs::entity e, const ActionDelay &delay)
+    {
+      world_entity.get([&](ActorSchedule &sched)
+      {
+        auto it = sched.nextTicks.find(e.id());
+        if (it == sched.nextTicks.end() || it->second == ActorSchedule::asleep)
+          return;
+        const int64_t tick = sched.now + std::max(delay.ticks, 1);
+        if (it->second != tick)
+          push_actor(sched, tick, e.id());
+      });
+    });
+  // removed or deleted actors leave right away: their queue entry turns stale and a sleeper leaves its chunk,
+  // so nothing waits for a scan near the player to find out it's gone
+  ecs.observer<const ActionDelay, const Position>()
+    .without<IsPlayer>()
+    .event(flecs::OnRemove)
+    .each([world_entity](flecs::entity e, const ActionDelay &, const Position &pos)
+    {
+      if (!world_entity.is_alive())
+        return;
+      world_entity.get([&](ActorSchedule &sched, ActivityZone &zone)
+      {
+        auto it = sched.nextTicks.find(e.id());
+        if (it == sched.nextTicks.end())
+          return;
+        const bool wasAsleep = it->second == ActorSchedule::asleep;
+        sched.nextTicks.erase(it);
+        if (!wasAsleep)
+          return;
+        // sleepers don't move, so the chunk of the position is the one it sleeps in
+        const size_t chunk = chunk_of(zone, size_t(pos.x), size_t(pos.y));
+        bool dropped = chunk < zone.chunks.size() && drop_sleeper(zone.chunks[chunk], e.id());
+        for (size_t i = 0; i < zone.chunks.size() && !dropped; ++i)
+          dropped = drop_sleeper(zone.chunks[i], e.id());
+        if (dropped)
+          zone.numSleeping--;
+      });
+    });
+}
+
+void advance_actor_schedule(flecs::world &ecs, ActorSchedule &sched, int64_t ticks,
+                            std::vector<flecs::entity_t> &due)
+{
+  sched.now += ticks;
+  due.clear();
+  while (!sched.queue.empty() && sched.queue.front().tick <= sched.now)
+  {
+    std::pop_heap(sched.queue.begin(), sched.queue.end(), is_later);
+    const ActorSchedule::Entry entry = sched.queue.back();
+    sched.queue.pop_back();
+    auto it = sched.nextTicks.find(entry.id);
+    if (it == sched.nextTicks.end() || it->second != entry.tick)
+      continue;
+    sched.nextTicks.erase(it);
+    if (flecs::entity(ecs, entry.id).is_alive())
+      due.push_back(entry.id);
+  }
+}
+
+void requeue_actors(flecs::world &ecs, ActorSchedule &sched, const std::vector<flecs::entity_t> &actors)
+{
+  // queued again only after the advance, so an actor acts at most once per advance
+  for (flecs::entity_t id : actors)
+    push_actor(sched, sched.now + get_action_delay(ecs, id), id);
+}
+
+static void put_to_sleep(flecs::world &ecs, ActorSchedule &sched, ActivityZone &zone, const DungeonData &dd,
+                         const DijkstraMapData &approach_map, std::vector<flecs::entity_t> &due)
+{
+  auto sleeps = [&](flecs::entity_t id)
+  {
+    bool far = false;
+    flecs::entity(ecs, id).get([&](const Position &pos)
+    {
+      const size_t x = size_t(pos.x);
+      const size_t y = size_t(pos.y);
+      if (dmaps::get_dmap_at(approach_map, x, y) <= zone.sleepDist)
+        return;
+      far = true;
+      zone.chunks[chunk_of(zone, x, y)].push_back(ActivityZone::Sleeper{id, y * dd.width + x, sched.now});
+      zone.numSleeping++;
+      sched.nextTicks[id] = ActorSchedule::asleep;
+    });
+    return far;
+  };
+  due.erase(std::remove_if(due.begin(), due.end(), sleeps), due.end());
+}
+
+static void wake_near(flecs::world &ecs, ActorSchedule &sched, ActivityZone &zone, const DungeonData &dd,
+                      const DijkstraMapData &approach_map)
+{
+  static std::vector<size_t> nearChunks;
+  nearChunks.clear();
+  // a tile within wakeDist steps of a source is within wakeDist of it along each axis too
+  const size_t reach = size_t(std::ceil(zone.wakeDist));
+  for (const DmapSource &src : approach_map.sourceList)
+  {
+    const size_t x = src.idx % dd.width;
+    const size_t y = src.idx / dd.width;
+    const size_t maxX = std::min(x + reach, dd.width - 1);
+    const size_t maxY = std::min(y + reach, dd.height - 1);
+    for (size_t cy = (y - std::min(y, reach)) / zone.chunkSize; cy <= maxY / zone.chunkSize; ++cy)
+      for (size_t cx = (x - std::min(x, reach)) / zone.chunkSize; cx <= maxX / zone.chunkSize; ++cx)
+        nearChunks.push_back(cy * zone.chunksX + cx);
+  }
+  std::sort(nearChunks.begin(), nearChunks.end());
+  nearChunks.erase(std::unique(nearChunks.begin(), nearChunks.end()), nearChunks.end());
+  for (size_t chunk : nearChunks)
+  {
+    std::vector<ActivityZone::Sleeper> &sleepers = zone.chunks[chunk];
+    auto wakes = [&](const ActivityZone::Sleeper &s)
+    {
+      if (dmaps::get_dmap_at(approach_map, s.tile % dd.width, s.tile / dd.width) > zone.wakeDist)
+        return false;
+      // catching up is just keeping the pace: the actor comes back at the tick it would have acted on
+      // had it been awake all along, without replaying the actions it slept through
+      const int64_t delay = get_action_delay(ecs, s.id);
+      const int64_t missed = (sched.now - s.since) / delay + 1;
+      push_actor(sched, s.since + missed * delay, s.id);
+      return true;
+    };
+    const size_t numBefore = sleepers.size();
+    sleepers.erase(std::remove_if(sleepers.begin(), sleepers.end(), wakes), sleepers.end());
+    zone.numSleeping -= numBefore - sleepers.size();
+  }
+}
+
+void update_actor_activity(flecs::world &ecs, ActorSchedule &sched, ActivityZone &zone, const DungeonData &dd,
+                           const DijkstraMapData &approach_map, std::vector<flecs::entity_t> &due)
+{
+  if (approach_map.version == 0 || dd.width == 0 || zone.chunkSize == 0)
+    return;
+  if (zone.chunks.empty())
+  {
+    zone.chunksX = (dd.width + zone.chunkSize - 1) / zone.chunkSize;
+    zone.chunks.resize(zone.chunksX * ((dd.height + zone.chunkSize - 1) / zone.chunkSize));
+  }
+  put_to_sleep(ecs, sched, zone, dd, approach_map, due);
+  wake_near(ecs, sched, zone, dd, approach_map);
+}
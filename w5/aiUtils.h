@@ -3,6 +3,7 @@
 #include "blackboard.h"
 #include <float.h>
 #include "math.h"
+#include "randomStream.h"
 
 template<typename T, typename U>
 inline int move_towards(const T &from, const U &to)
@@ -22,16 +23,28 @@ inline int inverse_move(int move)
          move == EA_MOVE_DOWN ? EA_MOVE_UP : move;
 }
 
+// decisions run on worker stages which can't create queries, so they share this one,
+// made by process_turn before the workers start; iterate it with .iter(ecs) to stay on the stage
+inline const flecs::query<const Position, const Team> &enemies_query(flecs::world &ecs)
+{
+  static auto enemiesQuery = ecs.query<const Position, const Team>();
+  return enemiesQuery;
+}
+
+inline int random_move(RandomStream &rs)
+{
+  return random_int(rs, EA_MOVE_START, EA_MOVE_END - 1);
+}
+
 template<typename Callable>
 inline void on_closest_enemy_pos(flecs::world &ecs, flecs::entity entity, Callable c)
 {
-  auto enemiesQuery = ecs.query<const Position, const Team>();
   entity.insert([&](const Position &pos, const Team &t, Action &a)
   {
     flecs::entity closestEnemy;
     float closestDist = FLT_MAX;
     Position closestPos;
-    enemiesQuery.each([&](flecs::entity enemy, const Position &epos, const Team &et)
+    enemies_query(ecs).iter(ecs).each([&](flecs::entity enemy, const Position &epos, const Team &et)
     {
       if (t.team == et.team)
         return;
@@ -140,13 +140,12 @@ struct FindEnemy : public BehNode
   BehResult update(flecs::world &ecs, flecs::entity entity, Blackboard &bb) override
   {
     BehResult res = BEH_FAIL;
-    auto enemiesQuery = ecs.query<const Position, const Team>();
     entity.insert([&](const Position &pos, const Team &t)
     {
       flecs::entity closestEnemy;
       float closestDist = FLT_MAX;
       Position closestPos;
-      enemiesQuery.each([&](flecs::entity enemy, const Position &epos, const Team &et)
+      enemies_query(ecs).iter(ecs).each([&](flecs::entity enemy, const Position &epos, const Team &et)
       {
         if (t.team == et.team)
           return;
@@ -213,13 +212,13 @@ struct Patrol : public BehNode
   BehResult update(flecs::world &, flecs::entity entity, Blackboard &bb) override
   {
     BehResult res = BEH_RUNNING;
-    entity.insert([&](Action &a, const Position &pos)
+    entity.insert([&](Action &a, const Position &pos, RandomStream &rs)
     {
       Position patrolPos = bb.get<Position>(pposBb);
       if (dist(pos, patrolPos) > patrolDist)
         a.action = move_towards(pos, patrolPos);
       else
-        a.action = GetRandomValue(EA_MOVE_START, EA_MOVE_END - 1); // do a random walk
+        a.action = random_move(rs); // do a random walk
     });
     return res;
   }
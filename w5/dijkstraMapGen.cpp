@@ -1,6 +1,8 @@
 #include "dijkstraMapGen.h"
 #include "ecsTypes.h"
 #include "dungeonUtils.h"
+#include "dmapEngine.h"
+#include <algorithm>
 
 template<typename Callable>
 static void query_dungeon_data(flecs::world &ecs, Callable c)
@@ -10,99 +12,141 @@ static void query_dungeon_data(flecs::world &ecs, Callable c)
   dungeonDataQuery.each(c);
 }
 
-template<typename Callable>
-static void query_characters_positions(flecs::world &ecs, Callable c)
+DmapHandle dmaps::register_map(flecs::world &ecs, const char *name, size_t radius, DmapFormat format)
 {
-  auto characterPositionQuery = ecs.query<const Position, const Team>();
-
-  characterPositionQuery.each(c);
+  DmapHandle handle = find_map(ecs, name);
+  if (handle != invalid_dmap_handle)
+    return handle;
+  ecs.entity("dmap_registry").insert([&](DmapRegistry &reg)
+  {
+    handle = reg.maps.size();
+    DijkstraMapData &dmap = reg.maps.emplace_back();
+    dmap.radius = radius;
+    dmap.format = format;
+  });
+  ecs.entity(name).set(DmapRef{handle});
+  return handle;
 }
 
-constexpr float invalid_tile_value = 1e5f;
-
-static void init_tiles(std::vector<float> &map, const DungeonData &dd)
+DmapHandle dmaps::find_map(flecs::world &ecs, const char *name)
 {
-  map.resize(dd.width * dd.height);
-  for (float &v : map)
-    v = invalid_tile_value;
+  DmapHandle handle = invalid_dmap_handle;
+  flecs::entity e = ecs.lookup(name);
+  if (e.is_valid())
+    e.get([&](const DmapRef &ref) { handle = ref.handle; });
+  return handle;
 }
 
-// scan version, could be implemented as Dijkstra version as well
-static void process_dmap(std::vector<float> &map, const DungeonData &dd)
+void dmaps::resolve_weights(flecs::world &ecs, DmapWeights &wt)
 {
-  bool done = false;
-  auto getMapAt = [&](size_t x, size_t y, float def)
+  using ResolvedWeight = DmapWeights::ResolvedWeight;
+  wt.resolved.clear();
+  for (const auto &pair : wt.weights)
   {
-    if (x < dd.width && y < dd.width && dd.tiles[y * dd.width + x] == dungeon::floor)
-      return map[y * dd.width + x];
-    return def;
-  };
-  auto getMinNei = [&](size_t x, size_t y)
+    const DmapHandle handle = find_map(ecs, pair.first.c_str());
+    if (handle != invalid_dmap_handle)
+      wt.resolved.push_back(ResolvedWeight{handle, pair.second});
+  }
+  std::sort(wt.resolved.begin(), wt.resolved.end(), [](const ResolvedWeight &lhs, const ResolvedWeight &rhs)
   {
-    float val = map[y * dd.width + x];
-    val = std::min(val, getMapAt(x - 1, y + 0, val));
-    val = std::min(val, getMapAt(x + 1, y + 0, val));
-    val = std::min(val, getMapAt(x + 0, y - 1, val));
-    val = std::min(val, getMapAt(x + 0, y + 1, val));
-    return val;
-  };
-  while (!done)
+    return lhs.handle < rhs.handle;
+  });
+  auto sameWeights = [&](const DmapCombined &comb)
   {
-    done = true;
-    for (size_t y = 0; y < dd.height; ++y)
-      for (size_t x = 0; x < dd.width; ++x)
+    return std::equal(comb.weights.begin(), comb.weights.end(), wt.resolved.begin(), wt.resolved.end(),
+      [](const ResolvedWeight &lhs, const ResolvedWeight &rhs)
       {
-        const size_t i = y * dd.width + x;
-        if (dd.tiles[i] != dungeon::floor)
-          continue;
-        const float myVal = getMapAt(x, y, invalid_tile_value);
-        const float minVal = getMinNei(x, y);
-        if (minVal < myVal - 1.f)
-        {
-          map[i] = minVal + 1.f;
-          done = false;
-        }
-      }
-  }
+        return lhs.handle == rhs.handle && lhs.wt.mult == rhs.wt.mult && lhs.wt.pow == rhs.wt.pow;
+      });
+  };
+  ecs.entity("dmap_registry").insert([&](DmapRegistry &reg)
+  {
+    auto it = std::find_if(reg.combined.begin(), reg.combined.end(), sameWeights);
+    wt.combined = size_t(it - reg.combined.begin());
+    if (it != reg.combined.end())
+      return;
+    DmapCombined comb;
+    comb.weights = wt.resolved;
+    comb.seenVersions.assign(comb.weights.size(), 0);
+    reg.combined.push_back(std::move(comb));
+  });
 }
 
-void dmaps::gen_player_approach_map(flecs::world &ecs, std::vector<float> &map)
+void dmaps::mark_demanded_maps(flecs::world &ecs, DmapRegistry &reg)
 {
-  query_dungeon_data(ecs, [&](const DungeonData &dd)
+  auto followersQuery = ecs.query<const DmapWeights>();
+  auto visualisedMapsQuery = ecs.query<const DmapRef, const VisualiseMap>();
+
+  reg.demanded.assign(reg.maps.size(), false);
+  followersQuery.each([&](const DmapWeights &wt)
   {
-    init_tiles(map, dd);
-    query_characters_positions(ecs, [&](const Position &pos, const Team &t)
-    {
-      if (t.team == 0) // player team hardcode
-        map[pos.y * dd.width + pos.x] = 0.f;
-    });
-    process_dmap(map, dd);
+    for (const DmapWeights::ResolvedWeight &rw : wt.resolved)
+      reg.demanded[rw.handle] = true;
+  });
+  visualisedMapsQuery.each([&](const DmapRef &ref, const VisualiseMap &)
+  {
+    reg.demanded[ref.handle] = true;
   });
 }
 
-void dmaps::gen_player_flee_map(flecs::world &ecs, std::vector<float> &map)
+void dmaps::update_group_maps(DmapRegistry &reg, const DungeonData &dd, const std::vector<DmapHandle> &handles,
+                              std::vector<std::vector<DmapSource>> &group_sources)
 {
-  gen_player_approach_map(ecs, map);
-  for (float &v : map)
-    if (v < invalid_tile_value)
-      v *= -1.2f;
-  query_dungeon_data(ecs, [&](const DungeonData &dd)
+  for (size_t i = 0; i < handles.size(); ++i)
   {
-    process_dmap(map, dd);
-  });
+    const DmapHandle handle = handles[i];
+    if (handle >= reg.maps.size())
+      continue;
+    // nothing marked yet means everything is needed
+    if (handle < reg.demanded.size() && !reg.demanded[handle])
+      continue;
+    update_dmap_sources(reg.maps[handle], dd, group_sources[i], reg.scratch);
+  }
 }
 
-void dmaps::gen_hive_pack_map(flecs::world &ecs, std::vector<float> &map)
+void dmaps::gen_team_approach_maps(flecs::world &ecs, DmapRegistry &reg, const std::vector<DmapHandle> &team_maps)
 {
-  auto hiveQuery = ecs.query<const Position, const Hive>();
+  auto characterPositionQuery = ecs.query<const Position, const Team>();
+
+  gen_group_maps(ecs, characterPositionQuery, reg, team_maps, [](const Team &t) { return t.team; });
+}
+
+void dmaps::gen_player_flee_map(flecs::world &ecs, DmapRegistry &reg, DmapHandle flee_handle,
+                                DmapHandle approach_handle)
+{
+  DijkstraMapData &dmap = reg.maps[flee_handle];
+  const DijkstraMapData &approach_map = reg.maps[approach_handle];
+  constexpr float fleeScale = -1.2f;
+  auto flee_value = [&](size_t idx) { return scaled_source_value(approach_map.map[idx], fleeScale); };
   query_dungeon_data(ecs, [&](const DungeonData &dd)
   {
-    init_tiles(map, dd);
-    hiveQuery.each([&](const Position &pos, const Hive &)
+    const bool sameSize = dmap.map.size() == approach_map.map.size();
+    if (sameSize && dmap.inputVersion == approach_map.version)
+    {
+      dmap.numReuses++;
+      return;
+    }
+    // changedTiles only cover the latest approach update
+    const bool missedUpdates = approach_map.version != dmap.inputVersion + 1;
+    dmap.inputVersion = approach_map.version;
+    if (approach_map.rebuilt || missedUpdates || !sameSize)
     {
-      map[pos.y * dd.width + pos.x] = 0.f;
-    });
-    process_dmap(map, dd);
+      rebuild_scaled_dmap(dmap, dd, approach_map.map, fleeScale, reg.scratch);
+      return;
+    }
+    // every approach tile is a flee source, so only the changed ones need a repair
+    std::vector<DmapSource> &changes = reg.scratch.fleeChanges;
+    changes.clear();
+    for (size_t idx : approach_map.changedTiles)
+      changes.push_back(DmapSource{idx, flee_value(idx)});
+    repair_dmap(dmap, dd, changes, reg.scratch);
   });
 }
 
+void dmaps::gen_hive_pack_map(flecs::world &ecs, DmapRegistry &reg, DmapHandle handle)
+{
+  auto hiveQuery = ecs.query<const Position, const Hive>();
+  const std::vector<DmapHandle> handles{handle};
+
+  gen_group_maps(ecs, hiveQuery, reg, handles, [](const Hive &) { return 0; });
+}
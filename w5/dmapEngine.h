@@ -0,0 +1,103 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include "ecsTypes.h"
+
+namespace dmaps
+{
+  constexpr float invalid_tile_value = 1e5f;
+
+  void init_tiles(std::vector<float> &map, const DungeonData &dd);
+
+  constexpr uint16_t invalid_packed_value = 0xffff;
+
+  // works for both whole dungeon and local maps, tiles outside of the stored window are invalid;
+  // Format has to match dmap.format, see with_dmap_format
+  template<DmapFormat Format>
+  inline float get_dmap_value(const DijkstraMapData &dmap, size_t x, size_t y)
+  {
+    // negative offsets wrap around and fail the same check
+    const size_t wx = x - dmap.winX;
+    const size_t wy = y - dmap.winY;
+    if (wx >= dmap.winWidth || wy >= dmap.winHeight)
+      return invalid_tile_value;
+    const size_t idx = wy * dmap.winWidth + wx;
+    if constexpr (Format == DF_FLOAT)
+      return dmap.map[idx];
+    else
+    {
+      const uint16_t v = dmap.packed[idx];
+      if (v == invalid_packed_value)
+        return invalid_tile_value;
+      if constexpr (Format == DF_STEPS)
+        return float(v);
+      else
+        return float(v) * dmap.packedScale + dmap.packedOffset;
+    }
+  }
+
+  // calls c with std::integral_constant of the map format, so loops over the map can use
+  // get_dmap_value<decltype(format)::value> without checking the format per tile
+  template<typename Callable>
+  inline void with_dmap_format(const DijkstraMapData &dmap, Callable c)
+  {
+    switch (dmap.format)
+    {
+      case DF_FLOAT: c(std::integral_constant<DmapFormat, DF_FLOAT>{}); break;
+      case DF_STEPS: c(std::integral_constant<DmapFormat, DF_STEPS>{}); break;
+      case DF_FIXED: c(std::integral_constant<DmapFormat, DF_FIXED>{}); break;
+    }
+  }
+
+  inline float get_dmap_at(const DijkstraMapData &dmap, size_t x, size_t y)
+  {
+    float res = invalid_tile_value;
+    with_dmap_format(dmap, [&](auto format) { res = get_dmap_value<decltype(format)::value>(dmap, x, y); });
+    return res;
+  }
+
+  constexpr size_t raster_min_floor_percent = 95;
+
+  // picks the raster engine for open maps and the queue one for sparse corridors
+  DmapEngine select_engine(const DungeonData &dd);
+
+  // functions below take the working buffers from `scratch` and leave nothing in them for the next call,
+  // so one scratch serves any number of maps as long as they are generated one at a time
+
+  // every floor tile with a value below invalid_tile_value is a source, relaxes the whole map
+  // with unit step cost either in a single queue pass or with repeated SIMD raster passes,
+  // both engines give exactly the same result
+  void process_dmap(std::vector<float> &map, const DungeonData &dd, DmapScratch &scratch, DmapEngine engine = DE_AUTO);
+
+  // old sweep-until-stable relaxation, kept as a reference for benchmarks
+  void process_dmap_scan(std::vector<float> &map, const DungeonData &dd);
+
+  // rebuilds a persistent map from its per tile sources
+  void rebuild_dmap(DijkstraMapData &dmap, const DungeonData &dd, DmapScratch &scratch);
+
+  // source value of a scaled map, rounded down to whole steps: a repair then gives exactly what a rebuild
+  // gives, with fractional sources the result would depend on which sources were repaired before
+  inline float scaled_source_value(float v, float scale)
+  {
+    return v < invalid_tile_value ? std::floor(v * scale) : v;
+  }
+
+  // rebuilds a map whose sources are every tile of `field` scaled by a negative `scale`, like flee maps
+  // made from an approach map; integer fields are ordered with a counting sort instead of a full sort
+  void rebuild_scaled_dmap(DijkstraMapData &dmap, const DungeonData &dd, const std::vector<float> &field, float scale,
+                           DmapScratch &scratch);
+
+  // sets new values for the listed source tiles (invalid_tile_value removes a source) and touches
+  // only the tiles whose distance changes, falls back to a rebuild if most of the map is affected;
+  // an empty change list keeps the map as it is; returns false if the map was rebuilt
+  bool repair_dmap(DijkstraMapData &dmap, const DungeonData &dd, const std::vector<DmapSource> &changes,
+                   DmapScratch &scratch);
+
+  // replaces a sparse source set with a new one, diffing it against the previous turn;
+  // local maps (radius > 0) are only updated here and recompute their small window on any change
+  bool update_dmap_sources(DijkstraMapData &dmap, const DungeonData &dd, std::vector<DmapSource> &sources,
+                           DmapScratch &scratch);
+};
+
@@ -1,45 +1,168 @@
 #include "ecsTypes.h"
 #include "dmapFollower.h"
+#include "dmapEngine.h"
+#include <algorithm>
 #include <cmath>
 
-void process_dmap_followers(flecs::world &ecs)
+// idx is a dungeon tile inside the window of the field
+static void combine_tile(DmapCombined &comb, const DmapRegistry &reg, const DungeonData &dd, size_t idx)
 {
-  auto processDmapFollowers = ecs.query<const Position, Action, const DmapWeights>();
-  auto dungeonDataQuery = ecs.query<const DungeonData>();
+  const size_t x = idx % dd.width;
+  const size_t y = idx / dd.width;
+  float sum = 0.f;
+  for (const DmapWeights::ResolvedWeight &rw : comb.weights)
+  {
+    const DijkstraMapData &dmap = reg.maps[rw.handle];
+    if (dmap.version == 0) // not generated yet
+      continue;
+    const float v = dmaps::get_dmap_at(dmap, x, y);
+    sum += v < 1e5f ? powf(v * rw.wt.mult, rw.wt.pow) : v;
+  }
+  comb.field[(y - comb.winY) * comb.winWidth + x - comb.winX] = sum;
+}
 
-  auto get_dmap_at = [&](const DijkstraMapData &dmap, const DungeonData &dd, size_t x, size_t y, float mult, float pow)
+// widx is a tile of the window, moves out of it are never picked
+static void pick_best_move(DmapCombined &comb, size_t widx)
+{
+  const size_t x = widx % comb.winWidth;
+  const size_t y = widx / comb.winWidth;
+  float minWt = comb.field[widx];
+  uint8_t best = EA_NOP;
+  auto consider = [&](uint8_t action, bool inside, size_t nidx)
   {
-    const float v = dmap.map[y * dd.width + x];
-    if (v < 1e5f)
-      return powf(v * mult, pow);
-    return v;
+    if (inside && comb.field[nidx] < minWt)
+    {
+      minWt = comb.field[nidx];
+      best = action;
+    }
   };
-  dungeonDataQuery.each([&](const DungeonData &dd)
+  // in the order of actions, so ties are resolved the same way as before
+  consider(EA_MOVE_LEFT, x > 0, widx - 1);
+  consider(EA_MOVE_RIGHT, x + 1 < comb.winWidth, widx + 1);
+  consider(EA_MOVE_DOWN, y + 1 < comb.winHeight, widx + comb.winWidth);
+  consider(EA_MOVE_UP, y > 0, widx - comb.winWidth);
+  comb.bestMove[widx] = best;
+}
+
+// union of the windows of the generated input maps, empty if none is generated yet
+static void fit_combined_window(DmapCombined &comb, const DmapRegistry &reg, const DungeonData &dd)
+{
+  size_t minX = dd.width;
+  size_t minY = dd.height;
+  size_t maxX = 0;
+  size_t maxY = 0;
+  for (const DmapWeights::ResolvedWeight &rw : comb.weights)
+  {
+    const DijkstraMapData &dmap = reg.maps[rw.handle];
+    if (dmap.version == 0 || dmap.winWidth == 0 || dmap.winHeight == 0)
+      continue;
+    minX = std::min(minX, dmap.winX);
+    minY = std::min(minY, dmap.winY);
+    maxX = std::max(maxX, dmap.winX + dmap.winWidth);
+    maxY = std::max(maxY, dmap.winY + dmap.winHeight);
+  }
+  comb.winX = minX < maxX ? minX : 0;
+  comb.winY = minY < maxY ? minY : 0;
+  comb.winWidth = minX < maxX ? maxX - minX : 0;
+  comb.winHeight = minY < maxY ? maxY - minY : 0;
+}
+
+static void refresh_combined(DmapCombined &comb, const DmapRegistry &reg, const DungeonData &dd,
+                             std::vector<size_t> &dirty)
+{
+  bool full = comb.field.empty();
+  bool changed = full;
+  dirty.clear();
+  for (size_t i = 0; i < comb.weights.size(); ++i)
   {
-    processDmapFollowers.each([&](const Position &pos, Action &act, const DmapWeights &wt)
+    const DijkstraMapData &dmap = reg.maps[comb.weights[i].handle];
+    if (dmap.version == comb.seenVersions[i])
+      continue;
+    changed = true;
+    // a single repair since the last refresh lists exactly the tiles to update,
+    // local maps are rebuilt on every change and may have moved their window
+    if (dmap.rebuilt || dmap.version != comb.seenVersions[i] + 1)
+      full = true;
+    else
+      dirty.insert(dirty.end(), dmap.changedTiles.begin(), dmap.changedTiles.end());
+    comb.seenVersions[i] = dmap.version;
+  }
+  if (!changed)
+    return;
+  if (full)
+  {
+    fit_combined_window(comb, reg, dd);
+    const size_t numTiles = comb.winWidth * comb.winHeight;
+    comb.field.assign(numTiles, 0.f);
+    comb.bestMove.resize(numTiles);
+    // map by map, same summation order as combine_tile
+    for (const DmapWeights::ResolvedWeight &rw : comb.weights)
     {
-      float moveWeights[EA_MOVE_END];
-      for (size_t i = 0; i < EA_MOVE_END; ++i)
-        moveWeights[i] = 0.f;
-      for (const auto &pair : wt.weights)
+      const DijkstraMapData &dmap = reg.maps[rw.handle];
+      if (dmap.version == 0)
+        continue;
+      dmaps::with_dmap_format(dmap, [&](auto format)
       {
-        ecs.entity(pair.first.c_str()).get([&](const DijkstraMapData &dmap)
-        {
-          moveWeights[EA_NOP]         += get_dmap_at(dmap, dd, pos.x+0, pos.y+0, pair.second.mult, pair.second.pow);
-          moveWeights[EA_MOVE_LEFT]   += get_dmap_at(dmap, dd, pos.x-1, pos.y+0, pair.second.mult, pair.second.pow);
-          moveWeights[EA_MOVE_RIGHT]  += get_dmap_at(dmap, dd, pos.x+1, pos.y+0, pair.second.mult, pair.second.pow);
-          moveWeights[EA_MOVE_UP]     += get_dmap_at(dmap, dd, pos.x+0, pos.y-1, pair.second.mult, pair.second.pow);
-          moveWeights[EA_MOVE_DOWN]   += get_dmap_at(dmap, dd, pos.x+0, pos.y+1, pair.second.mult, pair.second.pow);
-        });
-      }
-      float minWt = moveWeights[EA_NOP];
-      for (size_t i = 0; i < EA_MOVE_END; ++i)
-        if (moveWeights[i] < minWt)
-        {
-          minWt = moveWeights[i];
-          act.action = i;
-        }
+        for (size_t y = 0; y < comb.winHeight; ++y)
+          for (size_t x = 0; x < comb.winWidth; ++x)
+          {
+            const float v = dmaps::get_dmap_value<decltype(format)::value>(dmap, comb.winX + x, comb.winY + y);
+            comb.field[y * comb.winWidth + x] += v < 1e5f ? powf(v * rw.wt.mult, rw.wt.pow) : v;
+          }
+      });
+    }
+    for (size_t widx = 0; widx < numTiles; ++widx)
+      pick_best_move(comb, widx);
+    return;
+  }
+  // repaired maps cover the whole dungeon, so the field does too
+  for (size_t idx : dirty)
+    combine_tile(comb, reg, dd, idx);
+  // best moves of the neighbours depend on the changed tiles too
+  for (size_t idx : dirty)
+  {
+    const size_t widx = idx - comb.winY * comb.winWidth - comb.winX;
+    const size_t x = widx % comb.winWidth;
+    const size_t y = widx / comb.winWidth;
+    pick_best_move(comb, widx);
+    if (x > 0)
+      pick_best_move(comb, widx - 1);
+    if (x + 1 < comb.winWidth)
+      pick_best_move(comb, widx + 1);
+    if (y > 0)
+      pick_best_move(comb, widx - comb.winWidth);
+    if (y + 1 < comb.winHeight)
+      pick_best_move(comb, widx + comb.winWidth);
+  }
+}
+
+void combine_follower_dmaps(flecs::world &ecs)
+{
+  auto dungeonDataQuery = ecs.query<const DungeonData>();
+  auto dmapRegistryQuery = ecs.query<DmapRegistry>();
+
+  dungeonDataQuery.each([&](const DungeonData &dd)
+  {
+    dmapRegistryQuery.each([&](DmapRegistry &reg)
+    {
+      for (DmapCombined &comb : reg.combined)
+        refresh_combined(comb, reg, dd, reg.scratch.dirty);
     });
   });
 }
 
+void follow_dmap(const DmapRegistry &reg, const Position &pos, Action &act, const DmapWeights &wt)
+{
+  if (wt.combined >= reg.combined.size())
+    return;
+  const DmapCombined &comb = reg.combined[wt.combined];
+  // negative offsets wrap around and fail the same check, nothing is combined outside of the window
+  const size_t wx = size_t(pos.x) - comb.winX;
+  const size_t wy = size_t(pos.y) - comb.winY;
+  if (wx >= comb.winWidth || wy >= comb.winHeight)
+    return;
+  const uint8_t move = comb.bestMove[wy * comb.winWidth + wx];
+  if (move != EA_NOP)
+    act.action = move;
+}
+
@@ -1,5 +1,9 @@
 #pragma once
 #include <flecs.h>
+#include "ecsTypes.h"
 
-void process_dmap_followers(flecs::world &ecs);
+// refreshes the weighted fields shared by followers, only where their input maps changed
+void combine_follower_dmaps(flecs::world &ecs);
+// reads only the shared fields and writes the follower's own action, so followers can be split between workers
+void follow_dmap(const DmapRegistry &reg, const Position &pos, Action &act, const DmapWeights &wt);
 
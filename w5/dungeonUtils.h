@@ -7,6 +7,26 @@ namespace dungeon
   constexpr char wall = '#';
   constexpr char floor = ' ';
 
+  // fills dd.walkable from the tiles, has to be called again if they change
+  void init_walkable_tiles(DungeonData &dd);
   Position find_walkable_tile(flecs::world &ecs);
   bool is_tile_walkable(flecs::world &ecs, Position pos);
+
+  // adds an occupancy grid to the dungeon entity and keeps it in sync with entities which get
+  // or lose a MovePos, moves during a turn are recorded with move_occupant; an entity occupies
+  // a single tile, indexing it again frees the previous one
+  void init_occupancy(flecs::world &ecs, flecs::entity dungeon_entity);
+  // 0 for free tiles and tiles outside of the dungeon, the occupant may have moved on since
+  // if its MovePos was changed without move_occupant
+  flecs::entity_t get_occupant(const OccupancyGrid &occ, Position pos);
+  void move_occupant(OccupancyGrid &occ, flecs::entity_t e, Position to);
+  // random walkable tile without an occupant in O(1), drawn from the world RandomStream,
+  // {0, 0} if every tile is taken
+  Position find_free_tile(flecs::world &ecs);
+
+  // adds a pickup index to the dungeon entity, heal and powerup items are added and removed
+  // together with their Position
+  void init_pickups(flecs::world &ecs, flecs::entity dungeon_entity);
+  // appends the items on the tile to `items` and drops them from the index
+  void take_pickups(PickupIndex &index, Position pos, std::vector<flecs::entity_t> &items);
 };
@@ -1,8 +1,10 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <utility>
 
 // TODO: make a lot of seprate files
 struct Position;
@@ -81,10 +83,10 @@ struct Action
   int action = 0;
 };
 
-struct NumActions
+// game ticks between two actions of an actor, every player action advances the clock by the player's delay
+struct ActionDelay
 {
-  int numActions = 1;
-  int curActions = 0;
+  int ticks = 1;
 };
 
 struct MeleeDamage
@@ -133,27 +135,152 @@ struct TurnCounter
   int count = 0;
 };
 
+// the last messages in a ring of fixed size lines, pushing never allocates; lines are padded with spaces
+// and end with '\n', so a run of entries is also a piece of a text file, see actionLog.h
 struct ActionLog
 {
-  std::vector<std::string> log;
-  size_t capacity = 5;
+  static constexpr size_t entry_size = 64;
+  struct Entry
+  {
+    char text[entry_size];
+  };
+  std::vector<Entry> entries = std::vector<Entry>(1024); // never resized
+  size_t total = 0; // ever pushed, the newest entry is entries[(total - 1) % entries.size()]
+  size_t numShown = 5; // newest entries drawn on screen
 };
 
 struct BackgroundTile {};
 
+// actors by the tick of their next action, lives on the "world" entity; only the actors which are due
+// get a decision and an action, see actorSchedule.h
+struct ActorSchedule
+{
+  struct Entry
+  {
+    int64_t tick = 0;
+    uint64_t id = 0; // flecs entity id
+  };
+  static constexpr int64_t asleep = INT64_MIN; // next tick of the actors taken out by ActivityZone
+  std::vector<Entry> queue; // min heap by tick and then id, so actors due together keep a stable order
+  // per actor, the tick of its only live entry; setting ActionDelay again moves it and leaves the old one
+  // in the queue, entries which don't match are stale and dropped when popped
+  std::unordered_map<uint64_t, int64_t> nextTicks;
+  int64_t now = 0;
+};
+
+// actors farther than sleepDist steps on the approach map leave the schedule and sleep on their tile until
+// the map gets within wakeDist of it again, lives next to ActorSchedule, see actorSchedule.h
+struct ActivityZone
+{
+  struct Sleeper
+  {
+    uint64_t id = 0; // flecs entity id
+    size_t tile = 0;
+    int64_t since = 0; // tick of the action it slept through
+  };
+  float wakeDist = 32.f;
+  float sleepDist = 40.f; // above wakeDist, so actors at the border don't flip every turn
+  size_t chunkSize = 16; // tiles per side of a chunk
+  size_t chunksX = 0;
+  std::vector<std::vector<Sleeper>> chunks; // sleepers by the chunk of their tile
+  size_t numSleeping = 0;
+};
+
+// on the "world" entity, every RandomStream is derived from it
+struct WorldSeed
+{
+  uint64_t seed = 0;
+};
+
+// random numbers of a single entity, seeded from WorldSeed and the entity id when added;
+// drawing from it never depends on what other entities do, see randomStream.h
+struct RandomStream
+{
+  uint64_t state = 0;
+};
+
 struct DungeonData
 {
   std::vector<char> tiles; // for pathfinding
   size_t width;
   size_t height;
+  std::vector<Position> walkable; // every floor tile, see dungeon::init_walkable_tiles
+};
+
+// entities by the tile of their MovePos, lives next to DungeonData
+struct OccupancyGrid
+{
+  std::vector<uint64_t> occupants; // flecs entity ids, 0 for free tiles
+  std::unordered_map<uint64_t, size_t> tiles; // per occupant, the tile it is indexed under
+  size_t width = 0;
+  size_t height = 0;
+  // floor tiles with the unoccupied ones first, so a random free tile is a single pick
+  std::vector<size_t> freeOrder;
+  std::vector<size_t> freeSlots; // per tile, its place in freeOrder, invalid for walls
+  size_t numFree = 0;
+};
+
+// pickup items by tile, lives next to DungeonData
+struct PickupIndex
+{
+  std::unordered_map<size_t, std::vector<uint64_t>> items; // flecs entity ids
+  std::unordered_map<uint64_t, size_t> tiles; // per item, the tile it is indexed under
+  size_t width = 0;
+};
+
+// picks up heals and powerups it stands on
+struct Picker {};
+
+enum DmapEngine
+{
+  DE_AUTO = 0,
+  DE_QUEUE,
+  DE_RASTER
+};
+
+// how readers see a map, packed formats keep a uint16 copy next to the float map used for updates
+enum DmapFormat
+{
+  DF_FLOAT = 0,
+  DF_STEPS, // whole step counts, for maps with integer sources like approach maps
+  DF_FIXED // fixed point with a per map scale, for scaled maps like flee
+};
+
+struct DmapSource
+{
+  size_t idx = 0;
+  float value = 0.f;
 };
 
 struct DijkstraMapData
 {
-  std::vector<float> map;
+  std::vector<float> map; // covers only the window below
+  // local maps keep just the tiles within radius steps of their sources, 0 covers the whole dungeon
+  size_t radius = 0;
+  size_t winX = 0;
+  size_t winY = 0;
+  size_t winWidth = 0;
+  size_t winHeight = 0;
+  // kept between turns so the map is repaired instead of rebuilt when its sources change
+  std::vector<float> sources; // per tile, invalid value for non-sources
+  std::vector<DmapSource> sourceList; // sorted by tile, for sparse source sets
+  std::vector<size_t> changedTiles; // tiles which changed their value on the last repair
+  bool rebuilt = true; // last update rebuilt the whole map and changedTiles is empty
+  DmapEngine engine = DE_AUTO; // used for full rebuilds, repairs always go through the queue
+  DmapFormat format = DF_FLOAT;
+  std::vector<uint16_t> packed; // same window as map, fixed point value is packed * packedScale + packedOffset
+  float packedScale = 0.f; // chosen on the first packing
+  float packedOffset = 0.f;
+  size_t version = 0; // bumped on every rebuild or repair, changedTiles belong to the latest one
+  size_t inputVersion = 0; // for maps derived from another one, its version at the last update
+  // how the map was brought up to date on the turns it was needed
+  size_t numRebuilds = 0;
+  size_t numRepairs = 0;
+  size_t numReuses = 0;
 };
 
-struct VisualiseMap {};
+using DmapHandle = size_t;
+constexpr DmapHandle invalid_dmap_handle = DmapHandle(-1);
 
 struct DmapWeights
 {
@@ -162,7 +289,76 @@ struct DmapWeights
     float mult = 1.f;
     float pow = 1.f;
   };
+  struct ResolvedWeight
+  {
+    DmapHandle handle = invalid_dmap_handle;
+    WtData wt;
+  };
+  DmapWeights() = default;
+  DmapWeights(std::unordered_map<std::string, WtData> wts) : weights(std::move(wts)) {}
+
   std::unordered_map<std::string, WtData> weights;
+  // filled from weights when the component is set
+  std::vector<ResolvedWeight> resolved; // sorted by handle
+  size_t combined = invalid_dmap_handle; // index of the field shared by every follower with these weights
+};
+
+// weighted sum of several maps, refreshed only where its input maps changed
+struct DmapCombined
+{
+  std::vector<DmapWeights::ResolvedWeight> weights;
+  std::vector<size_t> seenVersions; // of the input maps at the last refresh
+  // union of the input map windows, a field of local maps only covers the tiles around their sources
+  size_t winX = 0;
+  size_t winY = 0;
+  size_t winWidth = 0;
+  size_t winHeight = 0;
+  std::vector<float> field; // covers only the window
+  std::vector<uint8_t> bestMove; // EA_NOP if no neighbour is strictly better than staying
 };
 
+// working buffers of map generation, kept between calls so their capacity is reused; a buffer is only
+// valid during the call using it, see dmapEngine.h
+struct DmapScratch
+{
+  // raster engine: vertical floor masks and row versions
+  std::vector<uint32_t> vertMask;
+  std::vector<uint32_t> rowVer;
+  std::vector<uint32_t> horzSeen;
+  std::vector<uint32_t> downSeen;
+  std::vector<uint32_t> upSeen;
+  // sources of a single propagation in the order of their value, and its FIFO of relaxed tiles
+  std::vector<DmapSource> seeds;
+  std::vector<size_t> queue;
+  std::vector<size_t> counts; // counting sort of integer fields
+  // repairs
+  std::vector<DmapSource> invalidated; // tiles with their value before the repair
+  std::vector<size_t> unchanged;
+  // local maps
+  DungeonData window;
+  std::vector<float> prevMap;
+  // source changes are kept while the map is repaired with them
+  std::vector<DmapSource> changes;
+  std::vector<DmapSource> fleeChanges;
+  std::vector<std::vector<DmapSource>> groupSources;
+  std::vector<size_t> dirty; // combined field tiles to refresh
+};
+
+// owns every dijkstra map, handles are indices and stay valid for the lifetime of the world
+struct DmapRegistry
+{
+  std::vector<DijkstraMapData> maps;
+  std::vector<DmapCombined> combined;
+  std::vector<bool> demanded; // maps with a follower or a visualiser this turn, only those are generated
+  DmapScratch scratch; // shared by every map, they are generated one at a time
+};
+
+// named entities refer to registry maps, so they can be found by name or visualised
+struct DmapRef
+{
+  DmapHandle handle = invalid_dmap_handle;
+};
+
+struct VisualiseMap {};
+
 struct Hive {};
@@ -0,0 +1,118 @@
+#include <flecs.h>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+#include "../ecsTypes.h"
+#include "../roguelike.h"
+#include "../dungeonGen.h"
+#include "../actionLog.h"
+
+// Runs the roguelike without a window: hw5_headless [turns] [seed] [script] [workers] [log file] [monsters]
+// The script is a string of player actions (l, r, u, d, p for pass) repeated for the whole run,
+// "auto" autoplays the player, without a script or with "-" the player moves randomly. The same arguments always give the same world state,
+// whatever the number of AI workers. With a log file the whole action log of the run is written to it, "-" skips it.
+// Monsters are spawned on top of the usual ones, so the AI workers have enough to share.
+
+static int script_action(char c)
+{
+  switch (c)
+  {
+    case 'l': return EA_MOVE_LEFT;
+    case 'r': return EA_MOVE_RIGHT;
+    case 'u': return EA_MOVE_UP;
+    case 'd': return EA_MOVE_DOWN;
+    default: return EA_PASS;
+  }
+}
+
+// order independent hash of everything alive, to compare runs
+static uint64_t world_checksum(flecs::world &ecs)
+{
+  auto stateQuery = ecs.query<const Position, const Hitpoints>();
+  uint64_t sum = 0;
+  stateQuery.each([&](flecs::entity e, const Position &pos, const Hitpoints &hp)
+  {
+    uint64_t h = 1469598103934665603ull;
+    for (uint64_t v : {e.id(), uint64_t(uint32_t(pos.x)), uint64_t(uint32_t(pos.y)),
+                       uint64_t(int64_t(hp.hitpoints * 16.f))})
+      h = (h ^ v) * 1099511628211ull;
+    sum += h;
+  });
+  return sum;
+}
+
+int main(int argc, const char **argv)
+{
+  const size_t numTurns = argc > 1 ? size_t(std::strtoull(argv[1], nullptr, 10)) : 10000;
+  const unsigned seed = argc > 2 ? unsigned(std::strtoul(argv[2], nullptr, 10)) : 42u;
+  const std::string script = argc > 3 && std::string(argv[3]) != "-" ? argv[3] : "";
+  if (argc > 4)
+    set_ai_workers(size_t(std::strtoull(argv[4], nullptr, 10)));
+  FILE *logFile = argc > 5 && std::string(argv[5]) != "-" ? fopen(argv[5], "wb") : nullptr;
+  const size_t numMonsters = argc > 6 ? size_t(std::strtoull(argv[6], nullptr, 10)) : 0;
+
+  flecs::world ecs;
+  {
+    constexpr size_t dungWidth = 50;
+    constexpr size_t dungHeight = 50;
+    std::vector<char> tiles(dungWidth * dungHeight);
+    gen_drunk_dungeon(tiles.data(), dungWidth, dungHeight, seed);
+    init_dungeon_headless(ecs, tiles.data(), dungWidth, dungHeight);
+  }
+  ecs.entity("world").set(WorldSeed{seed});
+  init_roguelike_headless(ecs);
+  spawn_monsters(ecs, numMonsters);
+
+  auto playerQuery = ecs.query<const IsPlayer, Action>();
+  auto turnCounterQuery = ecs.query<const TurnCounter>();
+  auto actionLogQuery = ecs.query<const ActionLog>();
+  auto activityQuery = ecs.query<const ActivityZone>();
+  size_t logCursor = 0;
+  size_t logLost = 0;
+  std::mt19937 inputRng(seed);
+  size_t turn = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (; turn < numTurns; ++turn)
+  {
+    if (script == "auto")
+      autoplay_player(ecs);
+    bool playerAlive = false;
+    playerQuery.each([&](const IsPlayer &, Action &a)
+    {
+      playerAlive = true;
+      if (script == "auto")
+        return;
+      if (!script.empty())
+        a.action = script_action(script[turn % script.size()]);
+      else
+        a.action = EA_MOVE_START + int(inputRng() % (EA_MOVE_END - EA_MOVE_START));
+    });
+    if (!playerAlive)
+      break;
+    process_turn(ecs);
+    if (logFile)
+      actionLogQuery.each([&](const ActionLog &l) { logLost += write_action_log(l, logFile, logCursor); });
+  }
+  const auto end = std::chrono::steady_clock::now();
+  const double seconds = std::chrono::duration<double>(end - start).count();
+
+  int npcTurns = 0;
+  turnCounterQuery.each([&](const TurnCounter &tc) { npcTurns = tc.count; });
+  size_t numSleeping = 0;
+  activityQuery.each([&](const ActivityZone &zone) { numSleeping = zone.numSleeping; });
+  printf("player actions %zu%s, npc turns %d, %zu npcs asleep\n", turn, turn < numTurns ? " (player died)" : "",
+         npcTurns, numSleeping);
+  printf("%.3f s, %.1f player actions/s, %.1f us per action\n", seconds, double(turn) / seconds,
+         seconds * 1e6 / double(turn > 0 ? turn : 1));
+  printf("checksum %016" PRIx64 "\n", world_checksum(ecs));
+  if (logFile)
+  {
+    fclose(logFile);
+    printf("action log: %zu entries written, %zu lost\n", logCursor - logLost, logLost);
+  }
+  return 0;
+}
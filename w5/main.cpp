@@ -266,10 +266,25 @@ int main(int /*argc*/, const char ** /*argv*/)
   camera.rotation = 0.f;
   camera.zoom = 0.125f;
 
+  // F toggles fast forward: the player is autoplayed for as many turns as fit in a frame,
+  // only the state after the last of them is drawn
+  constexpr double fastForwardBudgetMs = 12.0;
+  bool fastForward = false;
+  size_t turnsPerFrame = 0;
+
   SetTargetFPS(60);               // Set our game to run at 60 frames-per-second
   while (!WindowShouldClose())
   {
-    process_turn(ecs);
+    if (IsKeyPressed(KEY_F))
+    {
+      fastForward = !fastForward;
+      // keys pressed during fast forward would otherwise become the first manual action after it
+      enable_player_input(ecs, !fastForward);
+    }
+    if (fastForward)
+      turnsPerFrame = fast_forward(ecs, fastForwardBudgetMs);
+    else
+      process_turn(ecs);
     update_camera(camera, ecs);
 
     BeginDrawing();
@@ -278,6 +293,8 @@ int main(int /*argc*/, const char ** /*argv*/)
         ecs.progress();
       EndMode2D();
       print_stats(ecs);
+      if (fastForward)
+        DrawText(TextFormat("fast forward: %d turns per frame", int(turnsPerFrame)), GetRenderWidth() - 420, 20, 20, WHITE);
       // Advance to next frame. Process submitted rendering primitives.
     EndDrawing();
   }
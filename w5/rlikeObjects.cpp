@@ -9,28 +9,9 @@ flecs::entity create_hive(flecs::entity e)
   return e;
 }
 
-static Position find_free_dungeon_tile(flecs::world &ecs)
-{
-  auto findMonstersQuery = ecs.query<const Position, const Hitpoints>();
-  bool done = false;
-  while (!done)
-  {
-    done = true;
-    Position pos = dungeon::find_walkable_tile(ecs);
-    findMonstersQuery.each([&](const Position &p, const Hitpoints&)
-    {
-      if (p == pos)
-        done = false;
-    });
-    if (done)
-      return pos;
-  };
-  return {0, 0};
-}
-
 flecs::entity create_monster(flecs::world &ecs, Color col, const char *texture_src)
 {
-  Position pos = find_free_dungeon_tile(ecs);
+  Position pos = dungeon::find_free_tile(ecs);
 
   flecs::entity textureSrc = ecs.entity(texture_src);
   return ecs.entity()
@@ -41,14 +22,15 @@ flecs::entity create_monster(flecs::world &ecs, Color col, const char *texture_s
     .set(Color{col})
     .add<TextureSource>(textureSrc)
     .set(Team{1})
-    .set(NumActions{1, 0})
+    .set(ActionDelay{2})
     .set(MeleeDamage{20.f})
-    .set(Blackboard{});
+    .set(Blackboard{})
+    .add<RandomStream>();
 }
 
 void create_player(flecs::world &ecs, const char *texture_src)
 {
-  Position pos = find_free_dungeon_tile(ecs);
+  Position pos = dungeon::find_free_tile(ecs);
 
   flecs::entity textureSrc = ecs.entity(texture_src);
   ecs.entity("player")
@@ -57,12 +39,14 @@ void create_player(flecs::world &ecs, const char *texture_src)
     .set(Hitpoints{100.f})
     .set(Action{EA_NOP})
     .add<IsPlayer>()
+    .add<Picker>()
     .set(Team{0})
     .set(PlayerInput{})
-    .set(NumActions{2, 0})
+    .set(ActionDelay{1})
     .set(Color{255, 255, 255, 255})
     .add<TextureSource>(textureSrc)
-    .set(MeleeDamage{50.f});
+    .set(MeleeDamage{50.f})
+    .add<RandomStream>(); // for autoplay
 }
 
 void create_heal(flecs::world &ecs, int x, int y, float amount)
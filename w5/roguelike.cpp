@@ -3,150 +3,59 @@
 #include "raylib.h"
 #include "stateMachine.h"
 #include "aiLibrary.h"
+#include "aiUtils.h"
 #include "blackboard.h"
 #include "math.h"
 #include "dungeonUtils.h"
 #include "dijkstraMapGen.h"
+#include "dmapEngine.h"
 #include "dmapFollower.h"
 #include "dmapBeh.h"
 #include "rlikeObjects.h"
+#include "workerPool.h"
+#include "actionLog.h"
+#include "actorSchedule.h"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <utility>
 
 
-static void register_roguelike_systems(flecs::world &ecs)
+static void populate_roguelike(flecs::world &ecs)
 {
-  ecs.system<PlayerInput, Action, const IsPlayer>()
-    .each([&](PlayerInput &inp, Action &a, const IsPlayer)
+  // windowed runs get a new seed every time, headless runs set theirs before init
+  flecs::entity worldEntity = ecs.entity("world");
+  if (!worldEntity.has<WorldSeed>())
+    worldEntity.set(WorldSeed{uint64_t(std::random_device{}())});
+  ecs.observer<RandomStream>()
+    .event(flecs::OnAdd)
+    .each([worldEntity](flecs::entity e, RandomStream &rs)
     {
-      bool left = IsKeyDown(KEY_LEFT);
-      bool right = IsKeyDown(KEY_RIGHT);
-      bool up = IsKeyDown(KEY_UP);
-      bool down = IsKeyDown(KEY_DOWN);
-      if (left && !inp.left)
-        a.action = EA_MOVE_LEFT;
-      if (right && !inp.right)
-        a.action = EA_MOVE_RIGHT;
-      if (up && !inp.up)
-        a.action = EA_MOVE_UP;
-      if (down && !inp.down)
-        a.action = EA_MOVE_DOWN;
-      inp.left = left;
-      inp.right = right;
-      inp.up = up;
-      inp.down = down;
-
-      bool pass = IsKeyDown(KEY_SPACE);
-      if (pass && !inp.passed)
-        a.action = EA_PASS;
-      inp.passed = pass;
-    });
-  ecs.system<const Position, const Color>()
-    .with<TextureSource>(flecs::Wildcard)
-    .with<BackgroundTile>()
-    .each([&](flecs::entity e, const Position &pos, const Color color)
-    {
-      const auto textureSrc = e.target<TextureSource>();
-      DrawTextureQuad(*textureSrc.get<Texture2D>(),
-          Vector2{1, 1}, Vector2{0, 0},
-          Rectangle{float(pos.x) * tile_size, float(pos.y) * tile_size, tile_size, tile_size}, color);
-    });
-  ecs.system<const Position, const Color>()
-    .without<TextureSource>(flecs::Wildcard)
-    .each([&](const Position &pos, const Color color)
-    {
-      const Rectangle rect = {float(pos.x) * tile_size, float(pos.y) * tile_size, tile_size, tile_size};
-      DrawRectangleRec(rect, color);
-    });
-  ecs.system<const Position, const Color>()
-    .with<TextureSource>(flecs::Wildcard)
-    .without<BackgroundTile>()
-    .each([&](flecs::entity e, const Position &pos, const Color color)
-    {
-      const auto textureSrc = e.target<TextureSource>();
-      DrawTextureQuad(*textureSrc.get<Texture2D>(),
-          Vector2{1, 1}, Vector2{0, 0},
-          Rectangle{float(pos.x) * tile_size, float(pos.y) * tile_size, tile_size, tile_size}, color);
-    });
-  ecs.system<const Position, const Hitpoints>()
-    .each([&](const Position &pos, const Hitpoints &hp)
-    {
-      constexpr float hpPadding = 0.05f;
-      const float hpWidth = 1.f - 2.f * hpPadding;
-      const Rectangle underRect = {float(pos.x + hpPadding) * tile_size, float(pos.y-0.25f) * tile_size,
-                                   hpWidth * tile_size, 0.1f * tile_size};
-      DrawRectangleRec(underRect, BLACK);
-      const Rectangle hpRect = {float(pos.x + hpPadding) * tile_size, float(pos.y-0.25f) * tile_size,
-                                hp.hitpoints / 100.f * hpWidth * tile_size, 0.1f * tile_size};
-      DrawRectangleRec(hpRect, RED);
-    });
-
-  ecs.system<Texture2D>()
-    .each([&](Texture2D &tex)
-    {
-      SetTextureFilter(tex, TEXTURE_FILTER_POINT);
-    });
-  ecs.system<const DmapWeights>()
-    .with<VisualiseMap>()
-    .each([&](const DmapWeights &wt)
-    {
-      auto dungeonDataQuery = ecs.query<const DungeonData>();
-      dungeonDataQuery.each([&](const DungeonData &dd)
+      worldEntity.get([&](const WorldSeed &ws)
       {
-        for (size_t y = 0; y < dd.height; ++y)
-          for (size_t x = 0; x < dd.width; ++x)
-          {
-            float sum = 0.f;
-            for (const auto &pair : wt.weights)
-            {
-              ecs.entity(pair.first.c_str()).get([&](const DijkstraMapData &dmap)
-              {
-                float v = dmap.map[y * dd.width + x];
-                if (v < 1e5f)
-                  sum += powf(v * pair.second.mult, pair.second.pow);
-                else
-                  sum += v;
-              });
-            }
-            if (sum < 1e5f)
-              DrawText(TextFormat("%.1f", sum),
-                  int((float(x) + 0.2f) * tile_size), int((float(y) + 0.5f) * tile_size), 150, WHITE);
-          }
+        rs = make_random_stream(ws.seed, e.id());
       });
     });
-  ecs.system<const DijkstraMapData>()
-    .with<VisualiseMap>()
-    .each([&](const DijkstraMapData &dmap)
+  // spawn positions are drawn from the world's own stream
+  worldEntity.add<RandomStream>();
+  init_actor_schedule(ecs, worldEntity);
+
+  // maps are kept between turns and updated in place, followers refer to them by handle
+  ecs.entity("dmap_registry").set(DmapRegistry{});
+  // float maps, on a dungeon this size refreshing a packed copy on every repair costs more than
+  // the smaller reads save
+  dmaps::register_map(ecs, "approach_map");
+  dmaps::register_map(ecs, "flee_map");
+  // a local map, hive monsters pack up with the hive within a few steps of it and farther away
+  // only the approach map leads them
+  dmaps::register_map(ecs, "hive_map", 8);
+  ecs.observer<DmapWeights>()
+    .event(flecs::OnSet)
+    .each([&](DmapWeights &wt)
     {
-      auto dungeonDataQuery = ecs.query<const DungeonData>();
-      dungeonDataQuery.each([&](const DungeonData &dd)
-      {
-        for (size_t y = 0; y < dd.height; ++y)
-          for (size_t x = 0; x < dd.width; ++x)
-          {
-            const float val = dmap.map[y * dd.width + x];
-            if (val < 1e5f)
-              DrawText(TextFormat("%.1f", val),
-                  int((float(x) + 0.2f) * tile_size), int((float(y) + 0.5f) * tile_size), 150, WHITE);
-          }
-      });
+      dmaps::resolve_weights(ecs, wt);
     });
-}
-
-
-void init_roguelike(flecs::world &ecs)
-{
-  register_roguelike_systems(ecs);
-
-  ecs.entity("swordsman_tex")
-    .set(Texture2D{LoadTexture("assets/swordsman.png")});
-  ecs.entity("minotaur_tex")
-    .set(Texture2D{LoadTexture("assets/minotaur.png")});
-
-  ecs.observer<Texture2D>()
-    .event(flecs::OnRemove)
-    .each([](Texture2D texture)
-      {
-        UnloadTexture(texture);
-      });
 
   create_hive_monster(create_monster(ecs, Color{0xee, 0x00, 0xee, 0xff}, "minotaur_tex"));
   create_hive_monster(create_monster(ecs, Color{0xee, 0x00, 0xee, 0xff}, "minotaur_tex"));
@@ -158,36 +67,56 @@ void init_roguelike(flecs::world &ecs)
   ecs.entity("world")
     .set(TurnCounter{})
     .set(ActionLog{});
+
+  //ecs.entity("flee_map").add<VisualiseMap>();
+  ecs.entity("hive_follower_sum")
+    .set(DmapWeights{{{"hive_map", {1.f, 1.f}}, {"approach_map", {1.8f, 0.8f}}}})
+    .add<VisualiseMap>();
 }
 
-void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h)
+void init_roguelike_headless(flecs::world &ecs)
 {
-  flecs::entity wallTex = ecs.entity("wall_tex")
-    .set(Texture2D{LoadTexture("assets/wall.png")});
-  flecs::entity floorTex = ecs.entity("floor_tex")
-    .set(Texture2D{LoadTexture("assets/floor.png")});
+  populate_roguelike(ecs);
+}
 
-  std::vector<char> dungeonData;
-  dungeonData.resize(w * h);
-  for (size_t y = 0; y < h; ++y)
-    for (size_t x = 0; x < w; ++x)
-      dungeonData[y * w + x] = tiles[y * w + x];
-  ecs.entity("dungeon")
-    .set(DungeonData{dungeonData, w, h});
+void spawn_monsters(flecs::world &ecs, size_t count)
+{
+  auto occupancyQuery = ecs.query<const OccupancyGrid>();
+  for (size_t i = 0; i < count; ++i)
+  {
+    size_t numFree = 0;
+    occupancyQuery.each([&](const OccupancyGrid &occ) { numFree = occ.numFree; });
+    if (numFree == 0)
+      break;
+    flecs::entity monster = create_monster(ecs, Color{0xee, 0x00, 0xee, 0xff}, "minotaur_tex");
+    if (i % 3 == 0)
+      create_hive_monster(monster);
+    else if (i % 3 == 1)
+      create_player_approacher(monster);
+    else
+      create_hive_follower(monster);
+  }
+}
 
+static void create_dungeon_data(flecs::world &ecs, char *tiles, size_t w, size_t h)
+{
+  DungeonData dd;
+  dd.tiles.resize(w * h);
+  dd.width = w;
+  dd.height = h;
   for (size_t y = 0; y < h; ++y)
     for (size_t x = 0; x < w; ++x)
-    {
-      char tile = tiles[y * w + x];
-      flecs::entity tileEntity = ecs.entity()
-        .add<BackgroundTile>()
-        .set(Position{int(x), int(y)})
-        .set(Color{255, 255, 255, 255});
-      if (tile == dungeon::wall)
-        tileEntity.add<TextureSource>(wallTex);
-      else if (tile == dungeon::floor)
-        tileEntity.add<TextureSource>(floorTex);
-    }
+      dd.tiles[y * w + x] = tiles[y * w + x];
+  dungeon::init_walkable_tiles(dd);
+  flecs::entity dungeonEntity = ecs.entity("dungeon")
+    .set(std::move(dd));
+  dungeon::init_occupancy(ecs, dungeonEntity);
+  dungeon::init_pickups(ecs, dungeonEntity);
+}
+
+void init_dungeon_headless(flecs::world &ecs, char *tiles, size_t w, size_t h)
+{
+  create_dungeon_data(ecs, tiles, w, h);
 }
 
 
@@ -202,18 +131,6 @@ static bool is_player_acted(flecs::world &ecs)
   return playerActed;
 }
 
-static bool upd_player_actions_count(flecs::world &ecs)
-{
-  auto updPlayerActions = ecs.query<const IsPlayer, NumActions>();
-  bool actionsReached = false;
-  updPlayerActions.each([&](const IsPlayer, NumActions &na)
-  {
-    na.curActions = (na.curActions + 1) % na.numActions;
-    actionsReached |= na.curActions == 0;
-  });
-  return actionsReached;
-}
-
 static Position move_pos(Position pos, int action)
 {
   if (action == EA_MOVE_LEFT)
@@ -232,89 +149,117 @@ static void push_to_log(flecs::world &ecs, const char *msg)
   auto queryLog = ecs.query<ActionLog, const TurnCounter>();
   queryLog.each([&](ActionLog &l, const TurnCounter &c)
   {
-    l.log.push_back(std::to_string(c.count) + ": " + msg);
-    if (l.log.size() > l.capacity)
-      l.log.erase(l.log.begin());
+    push_action_log(l, c.count, msg);
   });
 }
 
-static void process_actions(flecs::world &ecs)
+// only the actors which are due act, everybody else keeps still
+static void process_actions(flecs::world &ecs, const std::vector<flecs::entity_t> &actors)
 {
-  auto processActions = ecs.query<Action, Position, MovePos, const MeleeDamage, const Team>();
-  auto processHeals = ecs.query<Action, Hitpoints>();
-  auto checkAttacks = ecs.query<const MovePos, Hitpoints, const Team>();
+  auto occupancyQuery = ecs.query<OccupancyGrid>();
+  static std::vector<std::pair<flecs::entity_t, float>> hits; // target and damage
+  static std::vector<flecs::entity_t> damaged;
+  hits.clear();
+  damaged.clear();
   // Process all actions
   ecs.defer([&]
   {
-    processHeals.each([&](Action &a, Hitpoints &hp)
-    {
-      if (a.action != EA_HEAL_SELF)
-        return;
-      a.action = EA_NOP;
-      push_to_log(ecs, "Monster healed itself");
-      hp.hitpoints += 10.f;
-
-    });
-    processActions.each([&](flecs::entity entity, Action &a, Position &pos, MovePos &mpos, const MeleeDamage &dmg, const Team &team)
+    for (flecs::entity_t id : actors)
+      flecs::entity(ecs, id).get([&](Action &a, Hitpoints &hp)
+      {
+        if (a.action != EA_HEAL_SELF)
+          return;
+        a.action = EA_NOP;
+        push_to_log(ecs, "Monster healed itself");
+        hp.hitpoints += 10.f;
+      });
+    occupancyQuery.each([&](OccupancyGrid &occ)
     {
-      Position nextPos = move_pos(pos, a.action);
-      bool blocked = !dungeon::is_tile_walkable(ecs, nextPos);
-      checkAttacks.each([&](flecs::entity enemy, const MovePos &epos, Hitpoints &hp, const Team &enemy_team)
+      for (flecs::entity_t id : actors)
       {
-        if (entity != enemy && epos == nextPos)
+        flecs::entity entity(ecs, id);
+        entity.get([&](Action &a, Position &pos, MovePos &mpos, const MeleeDamage &dmg, const Team &team)
         {
-          blocked = true;
-          if (team.team != enemy_team.team)
+          Position nextPos = move_pos(pos, a.action);
+          bool blocked = !dungeon::is_tile_walkable(ecs, nextPos);
+          const flecs::entity_t occupant = dungeon::get_occupant(occ, nextPos);
+          if (occupant != 0 && occupant != entity.id())
           {
-            push_to_log(ecs, "damaged entity");
-            hp.hitpoints -= dmg.damage;
+            flecs::entity enemy(ecs, occupant);
+            enemy.get([&](const MovePos &epos, const Team &enemy_team)
+            {
+              if (!(epos == nextPos))
+                return;
+              blocked = true;
+              if (team.team != enemy_team.team)
+                hits.emplace_back(occupant, dmg.damage);
+            });
           }
-        }
-      });
-      if (blocked)
-        a.action = EA_NOP;
-      else
-        mpos = nextPos;
+          if (blocked)
+            a.action = EA_NOP;
+          else
+          {
+            dungeon::move_occupant(occ, entity.id(), nextPos);
+            mpos = nextPos;
+          }
+        });
+      }
     });
+    // hits land once every move is resolved, so no target is written from inside its attacker's get
+    for (const auto &[id, damage] : hits)
+      flecs::entity(ecs, id).get([&](Hitpoints &hp)
+      {
+        push_to_log(ecs, "damaged entity");
+        hp.hitpoints -= damage;
+        damaged.push_back(id);
+      });
     // now move
-    processActions.each([&](Action &a, Position &pos, MovePos &mpos, const MeleeDamage &, const Team&)
-    {
-      pos = mpos;
-      a.action = EA_NOP;
-    });
+    for (flecs::entity_t id : actors)
+      flecs::entity(ecs, id).get([&](Action &a, Position &pos, MovePos &mpos)
+      {
+        pos = mpos;
+        a.action = EA_NOP;
+      });
   });
 
-  auto deleteAllDead = ecs.query<const Hitpoints>();
+  // only the ones hit this turn could have died
+  std::sort(damaged.begin(), damaged.end());
+  damaged.erase(std::unique(damaged.begin(), damaged.end()), damaged.end());
   ecs.defer([&]
   {
-    deleteAllDead.each([&](flecs::entity entity, const Hitpoints &hp)
+    for (flecs::entity_t id : damaged)
     {
-      if (hp.hitpoints <= 0.f)
-        entity.destruct();
-    });
+      flecs::entity entity(ecs, id);
+      entity.get([&](const Hitpoints &hp)
+      {
+        if (hp.hitpoints <= 0.f)
+          entity.destruct();
+      });
+    }
   });
 
-  auto playerPickup = ecs.query<const IsPlayer, const Position, Hitpoints, MeleeDamage>();
-  auto healPickup = ecs.query<const Position, const HealAmount>();
-  auto powerupPickup = ecs.query<const Position, const PowerupAmount>();
+  auto pickers = ecs.query<const Picker, const Position, Hitpoints, MeleeDamage>();
+  auto pickupIndexQuery = ecs.query<PickupIndex>();
+  static std::vector<flecs::entity_t> items;
   ecs.defer([&]
   {
-    playerPickup.each([&](const IsPlayer&, const Position &pos, Hitpoints &hp, MeleeDamage &dmg)
+    pickupIndexQuery.each([&](PickupIndex &index)
     {
-      healPickup.each([&](flecs::entity entity, const Position &ppos, const HealAmount &amt)
+      pickers.each([&](const Picker&, const Position &pos, Hitpoints &hp, MeleeDamage &dmg)
       {
-        if (pos == ppos)
+        items.clear();
+        dungeon::take_pickups(index, pos, items);
+        for (flecs::entity_t id : items)
         {
-          hp.hitpoints += amt.amount;
-          entity.destruct();
-        }
-      });
-      powerupPickup.each([&](flecs::entity entity, const Position &ppos, const PowerupAmount &amt)
-      {
-        if (pos == ppos)
-        {
-          dmg.damage += amt.amount;
-          entity.destruct();
+          flecs::entity item(ecs, id);
+          bool onTile = false;
+          if (item.is_alive())
+            item.get([&](const Position &ppos) { onTile = pos == ppos; });
+          if (!onTile) // gone or moved since it was indexed under this tile
+            continue;
+          item.get([&](const HealAmount &amt) { hp.hitpoints += amt.amount; });
+          item.get([&](const PowerupAmount &amt) { dmg.damage += amt.amount; });
+          item.destruct();
         }
       });
     });
@@ -329,104 +274,205 @@ static void push_info_to_bb(Blackboard &bb, const char *name, const T &val)
 }
 
 // sensors
-static void gather_world_info(flecs::world &ecs)
+static void gather_world_info(flecs::world &ecs, const std::vector<flecs::entity_t> &actors)
 {
-  auto gatherWorldInfo = ecs.query<Blackboard,
-                                          const Position, const Hitpoints,
-                                          const WorldInfoGatherer,
-                                          const Team>();
   auto alliesQuery = ecs.query<const Position, const Team>();
-  gatherWorldInfo.each([&](Blackboard &bb, const Position &pos, const Hitpoints &hp,
-                           WorldInfoGatherer, const Team &team)
+  for (flecs::entity_t id : actors)
   {
-    // first gather all needed names (without cache)
-    push_info_to_bb(bb, "hp", hp.hitpoints);
-    float numAllies = 0; // note float
-    float closestEnemyDist = 100.f;
-    alliesQuery.each([&](const Position &apos, const Team &ateam)
+    flecs::entity gatherer(ecs, id);
+    if (!gatherer.has<WorldInfoGatherer>())
+      continue;
+    gatherer.get([&](Blackboard &bb, const Position &pos, const Hitpoints &hp, const Team &team)
     {
-      constexpr float limitDist = 5.f;
-      if (team.team == ateam.team && dist_sq(pos, apos) < sqr(limitDist))
-        numAllies += 1.f;
-      if (team.team != ateam.team)
+      // first gather all needed names (without cache)
+      push_info_to_bb(bb, "hp", hp.hitpoints);
+      float numAllies = 0; // note float
+      float closestEnemyDist = 100.f;
+      alliesQuery.each([&](const Position &apos, const Team &ateam)
       {
-        const float enemyDist = dist(pos, apos);
-        if (enemyDist < closestEnemyDist)
-          closestEnemyDist = enemyDist;
-      }
+        constexpr float limitDist = 5.f;
+        if (team.team == ateam.team && dist_sq(pos, apos) < sqr(limitDist))
+          numAllies += 1.f;
+        if (team.team != ateam.team)
+        {
+          const float enemyDist = dist(pos, apos);
+          if (enemyDist < closestEnemyDist)
+            closestEnemyDist = enemyDist;
+        }
+      });
+      push_info_to_bb(bb, "alliesNum", numAllies);
+      push_info_to_bb(bb, "enemyDist", closestEnemyDist);
     });
-    push_info_to_bb(bb, "alliesNum", numAllies);
-    push_info_to_bb(bb, "enemyDist", closestEnemyDist);
-  });
+  }
+}
+
+static std::unique_ptr<WorkerPool> &ai_workers()
+{
+  static std::unique_ptr<WorkerPool> pool = std::make_unique<WorkerPool>(std::max(std::thread::hardware_concurrency(), 1u));
+  return pool;
+}
+
+void set_ai_workers(size_t num)
+{
+  ai_workers() = std::make_unique<WorkerPool>(num);
+}
+
+// every decision reads the world and writes only its own entity, so the actors of each pass are split between
+// workers, each deferring its changes to its own stage; stages are merged in order, so the result doesn't depend
+// on the number of workers. Passes don't overlap as an actor can be in several of them.
+static void run_decisions(flecs::world &ecs, const std::vector<std::function<void(flecs::world &, int32_t, int32_t)>> &passes)
+{
+  WorkerPool &pool = *ai_workers();
+  const int32_t numWorkers = int32_t(pool.size());
+  if (ecs.get_stage_count() != numWorkers)
+    ecs.set_stage_count(numWorkers);
+  ecs.readonly_begin(true);
+  for (const auto &pass : passes)
+    pool.run([&](size_t worker)
+    {
+      flecs::world stage = ecs.get_stage(int32_t(worker));
+      pass(stage, int32_t(worker), numWorkers);
+    });
+  ecs.readonly_end();
+}
+
+// the worker's share of the actors, in one piece so the merged stages keep the actors' order; the entities
+// belong to the stage, so they are only read with const gets and written with insert, which defers to the stage
+template<typename Callable>
+static void for_worker_actors(flecs::world &stage, const std::vector<flecs::entity_t> &actors, int32_t worker,
+                              int32_t num_workers, Callable c)
+{
+  const size_t begin = actors.size() * size_t(worker) / size_t(num_workers);
+  const size_t end = actors.size() * size_t(worker + 1) / size_t(num_workers);
+  for (size_t i = begin; i < end; ++i)
+    c(flecs::entity(stage, actors[i]));
 }
 
 void process_turn(flecs::world &ecs)
 {
-  auto stateMachineAct = ecs.query<StateMachine>();
-  auto behTreeUpdate = ecs.query<BehaviourTree, Blackboard>();
+  auto playerDelayQuery = ecs.query<const IsPlayer, const ActionDelay>();
+  auto scheduleQuery = ecs.query<ActorSchedule, ActivityZone>();
   auto turnIncrementer = ecs.query<TurnCounter>();
+  auto dungeonDataQuery = ecs.query<const DungeonData>();
+  auto dmapRegistryQuery = ecs.query<DmapRegistry>();
+  // maps are registered in the same order for every world, so the handles can be resolved once
+  static const DmapHandle approachMapHandle = dmaps::find_map(ecs, "approach_map");
+  static const DmapHandle fleeMapHandle = dmaps::find_map(ecs, "flee_map");
+  static const DmapHandle hiveMapHandle = dmaps::find_map(ecs, "hive_map");
+  static const std::vector<DmapHandle> teamApproachMaps = {approachMapHandle};
+  static std::vector<flecs::entity_t> dueActors;
+  static std::vector<flecs::entity_t> actors;
   if (is_player_acted(ecs))
   {
-    if (upd_player_actions_count(ecs))
+    flecs::entity_t player = 0;
+    int64_t playerDelay = 1;
+    playerDelayQuery.each([&](flecs::entity e, const IsPlayer &, const ActionDelay &delay)
     {
-      // Plan action for NPCs
-      gather_world_info(ecs);
-      ecs.defer([&]
+      player = e.id();
+      playerDelay = delay.ticks;
+    });
+    scheduleQuery.each([&](ActorSchedule &sched, ActivityZone &zone)
+    {
+      advance_actor_schedule(ecs, sched, playerDelay, dueActors);
+      dungeonDataQuery.each([&](const DungeonData &dd)
       {
-        stateMachineAct.each([&](flecs::entity e, StateMachine &sm)
+        dmapRegistryQuery.each([&](const DmapRegistry &reg)
         {
-          sm.act(0.f, ecs, e);
+          update_actor_activity(ecs, sched, zone, dd, reg.maps[approachMapHandle], dueActors);
         });
-        behTreeUpdate.each([&](flecs::entity e, BehaviourTree &bt, Blackboard &bb)
-        {
-          bt.update(ecs, e, bb);
+      });
+      requeue_actors(ecs, sched, dueActors);
+    });
+    if (!dueActors.empty())
+    {
+      // Plan action for NPCs
+      gather_world_info(ecs, dueActors);
+      enemies_query(ecs);
+      dmapRegistryQuery.each([&](const DmapRegistry &reg)
+      {
+        run_decisions(ecs, {
+          [&](flecs::world &stage, int32_t worker, int32_t num_workers)
+          {
+            for_worker_actors(stage, dueActors, worker, num_workers, [&](flecs::entity e)
+            {
+              if (e.has<StateMachine>())
+                e.insert([&](StateMachine &sm) { sm.act(0.f, stage, e); });
+            });
+          },
+          [&](flecs::world &stage, int32_t worker, int32_t num_workers)
+          {
+            for_worker_actors(stage, dueActors, worker, num_workers, [&](flecs::entity e)
+            {
+              if (e.has<BehaviourTree>() && e.has<Blackboard>())
+                e.insert([&](BehaviourTree &bt, Blackboard &bb) { bt.update(stage, e, bb); });
+            });
+          },
+          [&](flecs::world &stage, int32_t worker, int32_t num_workers)
+          {
+            for_worker_actors(stage, dueActors, worker, num_workers, [&](flecs::entity e)
+            {
+              // only Action is written, inserting the weights would mark them modified and
+              // rerun their OnSet resolve for every follower every turn
+              e.get([&](const Position &pos, const DmapWeights &wt)
+              {
+                e.insert([&](Action &act) { follow_dmap(reg, pos, act, wt); });
+              });
+            });
+          }
         });
-        process_dmap_followers(ecs);
       });
       turnIncrementer.each([](TurnCounter &tc) { tc.count++; });
     }
-    process_actions(ecs);
-
-    std::vector<float> approachMap;
-    dmaps::gen_player_approach_map(ecs, approachMap);
-    ecs.entity("approach_map")
-      .set(DijkstraMapData{approachMap});
-
-    std::vector<float> fleeMap;
-    dmaps::gen_player_flee_map(ecs, fleeMap);
-    ecs.entity("flee_map")
-      .set(DijkstraMapData{fleeMap});
-
-    std::vector<float> hiveMap;
-    dmaps::gen_hive_pack_map(ecs, hiveMap);
-    ecs.entity("hive_map")
-      .set(DijkstraMapData{hiveMap});
+    actors.clear();
+    if (player != 0)
+      actors.push_back(player);
+    actors.insert(actors.end(), dueActors.begin(), dueActors.end());
+    process_actions(ecs, actors);
 
-    //ecs.entity("flee_map").add<VisualiseMap>();
-    ecs.entity("hive_follower_sum")
-      .set(DmapWeights{{{"hive_map", {1.f, 1.f}}, {"approach_map", {1.8f, 0.8f}}}})
-      .add<VisualiseMap>();
+    dmapRegistryQuery.each([&](DmapRegistry &reg)
+    {
+      dmaps::mark_demanded_maps(ecs, reg);
+      // the flee map is made from the approach map and the activity zone measures distances on it
+      reg.demanded[approachMapHandle] = true;
+      // only the player team is approached for now, other teams get a map by adding its handle
+      dmaps::gen_team_approach_maps(ecs, reg, teamApproachMaps);
+      if (reg.demanded[fleeMapHandle])
+        dmaps::gen_player_flee_map(ecs, reg, fleeMapHandle, approachMapHandle);
+      dmaps::gen_hive_pack_map(ecs, reg, hiveMapHandle);
+    });
+    combine_follower_dmaps(ecs);
   }
 }
 
-void print_stats(flecs::world &ecs)
+void autoplay_player(flecs::world &ecs)
 {
-  auto playerStatsQuery = ecs.query<const IsPlayer, const Hitpoints, const MeleeDamage>();
-  playerStatsQuery.each([&](const IsPlayer &, const Hitpoints &hp, const MeleeDamage &dmg)
+  auto playerQuery = ecs.query<const IsPlayer, const Hitpoints>();
+  playerQuery.each([&](flecs::entity e, const IsPlayer &, const Hitpoints &hp)
   {
-    DrawText(TextFormat("hp: %d", int(hp.hitpoints)), 20, 20, 20, WHITE);
-    DrawText(TextFormat("power: %d", int(dmg.damage)), 20, 40, 20, WHITE);
-  });
-
-  auto actionLogQuery = ecs.query<const ActionLog>();
-  actionLogQuery.each([&](const ActionLog &l)
-  {
-    int yPos = GetRenderHeight() - 20;
-    for (const std::string &msg : l.log)
+    // wander while nobody is around, fight while healthy and back off when not
+    e.insert([&](Action &a, RandomStream &rs)
     {
-      DrawText(msg.c_str(), 20, yPos, 20, WHITE);
-      yPos -= 20;
-    }
+      a.action = random_move(rs);
+    });
+    on_closest_enemy_pos(ecs, e, [&](Action &a, const Position &pos, const Position &enemy_pos)
+    {
+      const int move = move_towards(pos, enemy_pos);
+      a.action = hp.hitpoints > 30.f ? move : inverse_move(move);
+    });
   });
 }
 
+size_t fast_forward(flecs::world &ecs, double budget_ms)
+{
+  const auto start = std::chrono::steady_clock::now();
+  size_t numTurns = 0;
+  do
+  {
+    autoplay_player(ecs);
+    if (!is_player_acted(ecs)) // no player left to play
+      break;
+    process_turn(ecs);
+    numTurns++;
+  } while (std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() < budget_ms);
+  return numTurns;
+}
@@ -4,7 +4,22 @@
 
 constexpr float tile_size = 512.f;
 
+// windowed game: textures, drawing and keyboard input on top of the headless world, see roguelikeWindow.cpp
 void init_roguelike(flecs::world &ecs);
 void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h);
+// the same world without textures, rendering and keyboard input, so turns run without a window;
+// the player acts by getting its Action set before process_turn
+void init_roguelike_headless(flecs::world &ecs);
+void init_dungeon_headless(flecs::world &ecs, char *tiles, size_t w, size_t h);
+// extra dungeon map followers on free tiles for load tests, stops early once no tile is free
+void spawn_monsters(flecs::world &ecs, size_t count);
 void process_turn(flecs::world &ecs);
+// NPC decisions are split between this many threads, all cores by default; any count gives the same turns
+void set_ai_workers(size_t num);
+// sets the player's action without input: wanders, fights the closest enemy and backs off when hurt
+void autoplay_player(flecs::world &ecs);
+// autoplays turns until budget_ms is spent or the player is gone, returns how many were run
+size_t fast_forward(flecs::world &ecs, double budget_ms);
+// keyboard control of the player, turned off while fast forward autoplays it
+void enable_player_input(flecs::world &ecs, bool enabled);
 void print_stats(flecs::world &ecs);
@@ -0,0 +1,221 @@
+#include "roguelike.h"
+#include "ecsTypes.h"
+#include "raylib.h"
+#include "dungeonUtils.h"
+#include "dmapEngine.h"
+#include "actionLog.h"
+#include <algorithm>
+
+// everything which needs a window: textures, drawing and keyboard input; the headless runner is built without it
+
+static void register_roguelike_systems(flecs::world &ecs)
+{
+  ecs.system<PlayerInput, Action, const IsPlayer>("player_input")
+    .each([&](PlayerInput &inp, Action &a, const IsPlayer)
+    {
+      bool left = IsKeyDown(KEY_LEFT);
+      bool right = IsKeyDown(KEY_RIGHT);
+      bool up = IsKeyDown(KEY_UP);
+      bool down = IsKeyDown(KEY_DOWN);
+      if (left && !inp.left)
+        a.action = EA_MOVE_LEFT;
+      if (right && !inp.right)
+        a.action = EA_MOVE_RIGHT;
+      if (up && !inp.up)
+        a.action = EA_MOVE_UP;
+      if (down && !inp.down)
+        a.action = EA_MOVE_DOWN;
+      inp.left = left;
+      inp.right = right;
+      inp.up = up;
+      inp.down = down;
+
+      bool pass = IsKeyDown(KEY_SPACE);
+      if (pass && !inp.passed)
+        a.action = EA_PASS;
+      inp.passed = pass;
+    });
+  ecs.system<const Position, const Color>()
+    .with<TextureSource>(flecs::Wildcard)
+    .with<BackgroundTile>()
+    .each([&](flecs::entity e, const Position &pos, const Color color)
+    {
+      const auto textureSrc = e.target<TextureSource>();
+      DrawTextureQuad(*textureSrc.get<Texture2D>(),
+          Vector2{1, 1}, Vector2{0, 0},
+          Rectangle{float(pos.x) * tile_size, float(pos.y) * tile_size, tile_size, tile_size}, color);
+    });
+  ecs.system<const Position, const Color>()
+    .without<TextureSource>(flecs::Wildcard)
+    .each([&](const Position &pos, const Color color)
+    {
+      const Rectangle rect = {float(pos.x) * tile_size, float(pos.y) * tile_size, tile_size, tile_size};
+      DrawRectangleRec(rect, color);
+    });
+  ecs.system<const Position, const Color>()
+    .with<TextureSource>(flecs::Wildcard)
+    .without<BackgroundTile>()
+    .each([&](flecs::entity e, const Position &pos, const Color color)
+    {
+      const auto textureSrc = e.target<TextureSource>();
+      DrawTextureQuad(*textureSrc.get<Texture2D>(),
+          Vector2{1, 1}, Vector2{0, 0},
+          Rectangle{float(pos.x) * tile_size, float(pos.y) * tile_size, tile_size, tile_size}, color);
+    });
+  ecs.system<const Position, const Hitpoints>()
+    .each([&](const Position &pos, const Hitpoints &hp)
+    {
+      constexpr float hpPadding = 0.05f;
+      const float hpWidth = 1.f - 2.f * hpPadding;
+      const Rectangle underRect = {float(pos.x + hpPadding) * tile_size, float(pos.y-0.25f) * tile_size,
+                                   hpWidth * tile_size, 0.1f * tile_size};
+      DrawRectangleRec(underRect, BLACK);
+      const Rectangle hpRect = {float(pos.x + hpPadding) * tile_size, float(pos.y-0.25f) * tile_size,
+                                hp.hitpoints / 100.f * hpWidth * tile_size, 0.1f * tile_size};
+      DrawRectangleRec(hpRect, RED);
+    });
+
+  ecs.system<Texture2D>()
+    .each([&](Texture2D &tex)
+    {
+      SetTextureFilter(tex, TEXTURE_FILTER_POINT);
+    });
+  ecs.system<const DmapWeights>()
+    .with<VisualiseMap>()
+    .each([&](const DmapWeights &wt)
+    {
+      auto dmapRegistryQuery = ecs.query<const DmapRegistry>();
+      dmapRegistryQuery.each([&](const DmapRegistry &reg)
+      {
+        if (wt.combined >= reg.combined.size())
+          return;
+        const DmapCombined &comb = reg.combined[wt.combined];
+        if (comb.field.size() != comb.winWidth * comb.winHeight)
+          return;
+        for (size_t y = comb.winY; y < comb.winY + comb.winHeight; ++y)
+          for (size_t x = comb.winX; x < comb.winX + comb.winWidth; ++x)
+          {
+            const float sum = comb.field[(y - comb.winY) * comb.winWidth + x - comb.winX];
+            if (sum < 1e5f)
+              DrawText(TextFormat("%.1f", sum),
+                  int((float(x) + 0.2f) * tile_size), int((float(y) + 0.5f) * tile_size), 150, WHITE);
+          }
+      });
+    });
+  ecs.system<const DmapRef>()
+    .with<VisualiseMap>()
+    .each([&](const DmapRef &ref)
+    {
+      auto dungeonDataQuery = ecs.query<const DungeonData>();
+      auto dmapRegistryQuery = ecs.query<const DmapRegistry>();
+      dungeonDataQuery.each([&](const DungeonData &dd)
+      {
+        dmapRegistryQuery.each([&](const DmapRegistry &reg)
+        {
+          const DijkstraMapData &dmap = reg.maps[ref.handle];
+          dmaps::with_dmap_format(dmap, [&](auto format)
+          {
+            for (size_t y = 0; y < dd.height; ++y)
+              for (size_t x = 0; x < dd.width; ++x)
+              {
+                const float val = dmaps::get_dmap_value<decltype(format)::value>(dmap, x, y);
+                if (val < 1e5f)
+                  DrawText(TextFormat("%.1f", val),
+                      int((float(x) + 0.2f) * tile_size), int((float(y) + 0.5f) * tile_size), 150, WHITE);
+              }
+          });
+        });
+      });
+    });
+}
+
+void init_roguelike(flecs::world &ecs)
+{
+  register_roguelike_systems(ecs);
+
+  ecs.entity("swordsman_tex")
+    .set(Texture2D{LoadTexture("assets/swordsman.png")});
+  ecs.entity("minotaur_tex")
+    .set(Texture2D{LoadTexture("assets/minotaur.png")});
+
+  ecs.observer<Texture2D>()
+    .event(flecs::OnRemove)
+    .each([](Texture2D texture)
+      {
+        UnloadTexture(texture);
+      });
+
+  init_roguelike_headless(ecs);
+}
+
+void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h)
+{
+  flecs::entity wallTex = ecs.entity("wall_tex")
+    .set(Texture2D{LoadTexture("assets/wall.png")});
+  flecs::entity floorTex = ecs.entity("floor_tex")
+    .set(Texture2D{LoadTexture("assets/floor.png")});
+
+  init_dungeon_headless(ecs, tiles, w, h);
+
+  for (size_t y = 0; y < h; ++y)
+    for (size_t x = 0; x < w; ++x)
+    {
+      char tile = tiles[y * w + x];
+      flecs::entity tileEntity = ecs.entity()
+        .add<BackgroundTile>()
+        .set(Position{int(x), int(y)})
+        .set(Color{255, 255, 255, 255});
+      if (tile == dungeon::wall)
+        tileEntity.add<TextureSource>(wallTex);
+      else if (tile == dungeon::floor)
+        tileEntity.add<TextureSource>(floorTex);
+    }
+}
+
+void enable_player_input(flecs::world &ecs, bool enabled)
+{
+  flecs::entity inputSystem = ecs.lookup("player_input");
+  if (!inputSystem)
+    return;
+  if (enabled)
+    inputSystem.enable();
+  else
+    inputSystem.disable();
+}
+
+void print_stats(flecs::world &ecs)
+{
+  auto playerStatsQuery = ecs.query<const IsPlayer, const Hitpoints, const MeleeDamage>();
+  playerStatsQuery.each([&](const IsPlayer &, const Hitpoints &hp, const MeleeDamage &dmg)
+  {
+    DrawText(TextFormat("hp: %d", int(hp.hitpoints)), 20, 20, 20, WHITE);
+    DrawText(TextFormat("power: %d", int(dmg.damage)), 20, 40, 20, WHITE);
+  });
+
+  auto dmapRegistryQuery = ecs.query<const DmapRegistry>();
+  auto dmapRefQuery = ecs.query<const DmapRef>();
+  dmapRegistryQuery.each([&](const DmapRegistry &reg)
+  {
+    int yPos = 60;
+    dmapRefQuery.each([&](flecs::entity e, const DmapRef &ref)
+    {
+      const DijkstraMapData &dmap = reg.maps[ref.handle];
+      DrawText(TextFormat("%s: rebuilt %d, repaired %d, reused %d", e.name().c_str(), int(dmap.numRebuilds),
+                          int(dmap.numRepairs), int(dmap.numReuses)), 20, yPos, 20, WHITE);
+      yPos += 20;
+    });
+  });
+
+  auto actionLogQuery = ecs.query<const ActionLog>();
+  actionLogQuery.each([&](const ActionLog &l)
+  {
+    int yPos = GetRenderHeight() - 20;
+    // oldest of the shown ones at the bottom
+    for (size_t i = std::min({l.numShown, l.total, l.entries.size()}); i > 0; --i)
+    {
+      const ActionLog::Entry &entry = get_action_log_entry(l, i - 1);
+      DrawText(TextFormat("%.*s", int(ActionLog::entry_size - 1), entry.text), 20, yPos, 20, WHITE);
+      yPos -= 20;
+    }
+  });
+}
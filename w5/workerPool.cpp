@@ -0,0 +1,62 @@
+#include "workerPool.h"
+
+WorkerPool::WorkerPool(size_t num_workers) : numWorkers(num_workers > 0 ? num_workers : 1)
+{
+  for (size_t i = 1; i < numWorkers; ++i)
+    threads.emplace_back([this, i]() { workerLoop(i); });
+}
+
+WorkerPool::~WorkerPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quit = true;
+  }
+  jobReady.notify_all();
+  for (std::thread &thread : threads)
+    thread.join();
+}
+
+void WorkerPool::workerLoop(size_t worker)
+{
+  size_t seenJob = 0;
+  while (true)
+  {
+    const std::function<void(size_t)> *curJob = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      jobReady.wait(lock, [&]() { return quit || jobIdx != seenJob; });
+      if (quit)
+        return;
+      seenJob = jobIdx;
+      curJob = job;
+    }
+    (*curJob)(worker);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--numBusy == 0)
+        jobDone.notify_one();
+    }
+  }
+}
+
+void WorkerPool::run(const std::function<void(size_t)> &in_job)
+{
+  if (threads.empty())
+  {
+    in_job(0);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    job = &in_job;
+    jobIdx++;
+    numBusy = threads.size();
+  }
+  jobReady.notify_all();
+  in_job(0);
+  std::unique_lock<std::mutex> lock(mutex);
+  jobDone.wait(lock, [&]() { return numBusy == 0; });
+  job = nullptr;
+}
+
@@ -0,0 +1,33 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// threads kept for the whole run, each job is called once per worker with its index
+class WorkerPool
+{
+  size_t numWorkers = 1;
+  std::vector<std::thread> threads;
+  std::mutex mutex;
+  std::condition_variable jobReady;
+  std::condition_variable jobDone;
+  const std::function<void(size_t)> *job = nullptr;
+  size_t jobIdx = 0;
+  size_t numBusy = 0;
+  bool quit = false;
+
+  void workerLoop(size_t worker);
+public:
+  explicit WorkerPool(size_t num_workers);
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  size_t size() const { return numWorkers; }
+  // the calling thread works as worker 0, returns when every worker is done
+  void run(const std::function<void(size_t)> &in_job);
+};
+